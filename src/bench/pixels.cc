@@ -0,0 +1,120 @@
+// Microbenchmarks of the Pixels kernels against the per pixel path the
+// renderer used before (bit extraction from both tile bytes followed by
+// a palette lookup for every pixel).
+
+#include "gb/pixels.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+namespace {
+
+const int WIDTH = 160;
+const int LINES = 1 << 16;
+
+// what GR::pixel_tile_() + GR::map_palette_() did for one pixel
+reg_t reference_pixel(reg_t byte1, reg_t byte2, int x, reg_t palette)
+{
+  int   const bit         = 7 - x;
+  reg_t const pixel_bit_1 = (byte1 & (1 << bit)) > 0;
+  reg_t const pixel_bit_2 = (byte2 & (1 << bit)) > 0;
+  reg_t const color       = (pixel_bit_2 << 1) | pixel_bit_1;
+
+  return (palette >> (2*color)) & 0x03;
+}
+
+template <typename Fn>
+void run(char const* name, Fn&& fn)
+{
+  auto const start = std::chrono::steady_clock::now();
+  unsigned sum = 0;
+  for (int i = 0; i < LINES; ++i)
+    sum += fn(i);
+  auto const end = std::chrono::steady_clock::now();
+
+  auto const ns = std::chrono::duration<double, std::nano>(end - start).count();
+  printf("%-28s %8.1f ns/line  (%u)\n", name, ns / LINES, sum);
+}
+
+} // namespace
+
+int main()
+{
+  std::mt19937 rng(42);
+  std::array<reg_t, 2 * WIDTH / 8> tile_bytes;
+  for (auto& b : tile_bytes)
+    b = rng();
+
+  std::array<reg_t, WIDTH> colors;
+  std::array<reg_t, WIDTH> line;
+  for (auto& c : colors)
+    c = rng() & 0x03;
+
+  run("reference decode+palette", [&] (int i) {
+    reg_t const palette = 0xE4 ^ i;
+    for (int x = 0; x < WIDTH; ++x) {
+      auto const t = (x / 8) * 2;
+      line[x] = reference_pixel(tile_bytes[t], tile_bytes[t + 1], x % 8, palette);
+    }
+    return line[i % WIDTH];
+  });
+
+  run("Pixels::decode+map", [&] (int i) {
+    reg_t const palette = 0xE4 ^ i;
+    for (int x = 0; x < WIDTH; x += 8)
+      Pixels::decode(tile_bytes[x / 4], tile_bytes[x / 4 + 1], &colors[x]);
+    Pixels::map(colors.data(), line.data(), WIDTH, palette);
+    return line[i % WIDTH];
+  });
+
+  run("Pixels::map", [&] (int i) {
+    Pixels::map(colors.data(), line.data(), WIDTH, 0xE4 ^ i);
+    return line[i % WIDTH];
+  });
+
+  run("reference sprite merge", [&] (int i) {
+    reg_t const palette = 0xD2 ^ i;
+    for (int s = 0; s < 10; ++s) {
+      auto const x0 = (s * 15 + i) % (WIDTH - 8);
+      for (int x = 0; x < 8; ++x) {
+        auto const c = colors[(x0 + 3) % (WIDTH - 8) + x];
+        if (c != 0 and colors[x0 + x] == 0)
+          line[x0 + x] = (palette >> (2*c)) & 0x03;
+      }
+    }
+    return line[i % WIDTH];
+  });
+
+  run("Pixels::merge", [&] (int i) {
+    reg_t const palette = 0xD2 ^ i;
+    for (int s = 0; s < 10; ++s) {
+      auto const x0 = (s * 15 + i) % (WIDTH - 8);
+      Pixels::merge(&colors[(x0 + 3) % (WIDTH - 8)], &colors[x0], &line[x0], palette, false);
+    }
+    return line[i % WIDTH];
+  });
+
+  std::array<uint32_t, 4>     lut = {{ 0xFF9BBC0F, 0xFF8BAC0F, 0xFF306230, 0xFF0F380F }};
+  std::array<uint32_t, WIDTH> rgba;
+
+  run("reference host colors", [&] (int i) {
+    for (int x = 0; x < WIDTH; ++x) {
+      switch (colors[x]) {
+      case 3:  rgba[x] = 0xFF0F380F; break;
+      case 2:  rgba[x] = 0xFF306230; break;
+      case 1:  rgba[x] = 0xFF8BAC0F; break;
+      default: rgba[x] = 0xFF9BBC0F; break;
+      }
+    }
+    return rgba[i % WIDTH];
+  });
+
+  run("Pixels::expand", [&] (int i) {
+    Pixels::expand(colors.data(), rgba.data(), WIDTH, lut.data());
+    return rgba[i % WIDTH];
+  });
+
+  return 0;
+}
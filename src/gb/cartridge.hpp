@@ -22,9 +22,22 @@ public:
     Unsupported,
   };
 
+  Cartridge(uint64_t const& cycle)
+    : cycle_(cycle)
+  {
+  }
+
   Error load(std::vector<reg_t> const& data)
   {
-    rom_ = data;
+    return load(std::make_shared<cartridge_t const>(data));
+  }
+
+  Error load(rom_t const& rom)
+  {
+    if (rom.get() == nullptr or rom->size() < 0x8000)
+      return Error(Error::Code::RomNotSupported);
+
+    rom_ = rom;
     mbc_ = gen_mbc_();
 
     if (mbc_.get() == nullptr)
@@ -33,16 +46,34 @@ public:
     return Error::NoError();
   }
 
+  // the save holds the ram followed by the mapper's extra state (rtc)
   Error load_ram(std::vector<reg_t> const& data)
   {
-    ram_ = data;
+    if (mbc_.get() == nullptr)
+      return Error(Error::Code::RomNotSupported);
+
+    auto const extra = mbc_->extra_size();
+    if (extra and data.size() % 0x0800 == extra) {
+      ram_.assign(data.begin(), data.end() - extra);
+      mbc_->load_extra(&data[data.size() - extra]);
+    }
+    else {
+      ram_ = data;
+    }
+
+    ram_.resize(ram_size_());
 
     return Error::NoError();
   }
 
   mem_t ram() const
   {
-    return ram_;
+    if (mbc_.get() == nullptr)
+      return ram_;
+
+    mem_t data = ram_;
+    mbc_->save_extra(data);
+    return data;
   }
 
   void power_on()
@@ -53,7 +84,10 @@ public:
       count_rom_banks(),
       count_ram_banks());
 
-    ram_.resize(0x2000 * (count_ram_banks()+1));
+    ram_.resize(ram_size_());
+
+    if (mbc_.get() != nullptr)
+      mbc_->power_on();
   }
 
   reg_t read(wide_reg_t addr) const
@@ -66,8 +100,13 @@ public:
     mbc_->write(addr, value);
   }
 
+  reg_t const* data(wide_reg_t addr) const
+  {
+    return mbc_->data(addr);
+  }
+
   MbcType mbc_type() const {
-    switch (rom_[0x0147]) {
+    switch ((*rom_)[0x0147]) {
     case 0x00: return MbcType::RomOnly;
     case 0x01:
     case 0x02:
@@ -76,6 +115,11 @@ public:
     case 0x06: return MbcType::Mbc2;
     case 0x08:
     case 0x09: return MbcType::RomRam;
+    case 0x0F:
+    case 0x10:
+    case 0x11:
+    case 0x12:
+    case 0x13: return MbcType::Mbc3;
     case 0x19:
     case 0x1A:
     case 0x1B:
@@ -89,7 +133,8 @@ public:
 
   wide_reg_t count_rom_banks() const
   {
-    switch (rom_[0x0148]) {
+    switch ((*rom_)[0x0148]) {
+    case 0x00: return 2;
     case 0x01: return 4;
     case 0x02: return 8;
     case 0x03: return 16;
@@ -108,7 +153,7 @@ public:
 
   wide_reg_t count_ram_banks() const
   {
-    switch (rom_[0x0149]) {
+    switch ((*rom_)[0x0149]) {
     case 0x01: return 1;
     case 0x02: return 1;
     case 0x03: return 4;
@@ -119,25 +164,62 @@ public:
     }
   }
 
+  // the ram and the mapper registers
+  template <typename Archive>
+  void state(Archive& archive)
+  {
+    archive(ram_);
+    mbc_->state(archive);
+  }
+
 private:
+  // bank counts the mappers wrap their bank registers to. The rom image
+  // wins over the header, the ram always has at least one bank.
+  size_t rom_banks_() const
+  {
+    auto const banks = count_rom_banks();
+    auto const image = rom_->size() / 0x4000;
+
+    return banks > 0 and banks < image ? banks : image;
+  }
+
+  size_t ram_banks_() const
+  {
+    return count_ram_banks() > 0 ? count_ram_banks() : 1;
+  }
+
+  size_t ram_size_() const
+  {
+    return 0x2000 * ram_banks_();
+  }
+
+  bool has_rtc_() const
+  {
+    return (*rom_)[0x0147] == 0x0F or (*rom_)[0x0147] == 0x10;
+  }
+
   std::unique_ptr<MBC> gen_mbc_()
   {
     switch (mbc_type()) {
     case MbcType::RomOnly:
-      return std::make_unique<MBCRomOnly>(rom_);
+      return std::make_unique<MBCRomOnly>(*rom_);
     case MbcType::Mbc1:
-      return std::make_unique<MBC1>(rom_, ram_);
+      return std::make_unique<MBC1>(*rom_, ram_, rom_banks_(), ram_banks_());
     case MbcType::Mbc2:
-      return std::make_unique<MBC2>(rom_, ram_);
+      return std::make_unique<MBC2>(*rom_, ram_, rom_banks_());
+    case MbcType::Mbc3:
+      return std::make_unique<MBC3>(
+        *rom_, ram_, rom_banks_(), ram_banks_(), cycle_, has_rtc_());
     case MbcType::Mbc5:
-      return std::make_unique<MBC5>(rom_, ram_);
+      return std::make_unique<MBC5>(*rom_, ram_, rom_banks_(), ram_banks_());
     default:
       return std::unique_ptr<MBC>();
     }
   }
 
 private:
+  uint64_t const&      cycle_;
   std::unique_ptr<MBC> mbc_;
-  mem_t                rom_ = mem_t();
+  rom_t                rom_;
   mem_t                ram_ = mem_t();
 };
@@ -30,6 +30,12 @@ public:
 		mm_.write(0xffff, 0xff); // interrupt enable
 	}
 
+	template <typename Archive>
+	void state(Archive& archive)
+	{
+		archive(a_, b_, c_, d_, e_, f_, h_, l_, sp_, pc_, ime_, halted_, cycles_, cycle_);
+	}
+
 	wide_reg_t pc() const { return pc_; }
 	wide_reg_t sp() const { return sp_; }
 	void sp(wide_reg_t value) { sp_ = value; }
@@ -1121,7 +1127,7 @@ lab_rla:         // 0x17
 		rl_(a()); pc_ += 1; cycles_ = 4;
 			return;
 lab_jr_r8:       // 0x18
-		pc_ += static_cast<int8_t>(b1()) + 2; cycles_ = 8;
+		pc_ += static_cast<int8_t>(b1()) + 2; cycles_ = 12;
 		return;
 lab_add_hl_de:   // 0x19
 		hl(add_16(de(), hl())); pc_ += 1; cycles_ = 8;
@@ -1151,7 +1157,7 @@ lab_jr_nz_r8:    // 0x20
 				r = 0;
 			}
 			pc_ += r + 2;
-			cycles_ = 8;
+			cycles_ = zero_flag() ? 8 : 12;
 		}
 		return;
 lab_ld_hl_d16:   // 0x21
@@ -1205,7 +1211,7 @@ lab_daa:         // 0x27
 		return;
 lab_jr_z_r8:     // 0x28
 		pc_ += 2 + ((zero_flag())  ? static_cast<int8_t>(b1()) : 0);
-		cycles_ = 8;
+		cycles_ = (zero_flag()) ? 12 : 8;
 		return;
 lab_add_hl_hl:   // 0x29
 		hl(add_16(hl(), hl())); pc_ += 1; cycles_ = 8;
@@ -1233,7 +1239,7 @@ lab_cpl:         // 0x2f
 		return;
 lab_jr_nc_r8:    // 0x30
 		pc_ += 2 + ((not carry_flag()) ? static_cast<int8_t>(b1()) : 0);
-		cycles_ = 8;
+		cycles_ = (not carry_flag()) ? 12 : 8;
 		return;
 lab_ld_sp_d16:   // 0x31
 		sp(nn()); pc_ += 3; cycles_ = 12;
@@ -1266,7 +1272,7 @@ lab_scf:         // 0x37
 		return;
 lab_jr_c_r8:     // 0x38
 		pc_    += 2 + ((carry_flag()) ? static_cast<int8_t>(b1()) : 0);
-		cycles_ = 8;
+		cycles_ = (carry_flag()) ? 12 : 8;
 		return;
 lab_add_hl_sp:   // 0x39
 		hl(add_16(sp(), hl())); pc_ += 1; cycles_ = 8;
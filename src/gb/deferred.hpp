@@ -0,0 +1,169 @@
+#pragma once
+
+#include "types.h"
+
+#include "scanline.hpp"
+#include "tiles.hpp"
+
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Renders lines on worker threads. The emulation only records the
+// registers of each line together with a snapshot of vram and oam, a
+// new snapshot is taken when one of them changed since the last line.
+// Lines are handed to the workers in batches; wait() returns once all
+// of them are drawn. The output is the same as rendering inline since
+// both go through Scanline. Line is the line destination of the GR
+// output policy.
+template <typename Line>
+class Deferred
+{
+public:
+  Deferred(int threads)
+  {
+    for (int i = 0; i < threads; ++i)
+      workers_.emplace_back([this] { work_(); });
+  }
+
+  ~Deferred()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    work_ready_.notify_all();
+
+    for (auto& worker : workers_)
+      worker.join();
+  }
+
+  Deferred(Deferred const&) = delete;
+  Deferred& operator=(Deferred const&) = delete;
+
+  void render(
+    int                          line,
+    Scanline::Registers const&   regs,
+    Scanline::vram_t const&      vram,
+    uint32_t                     vram_generation,
+    Scanline::oam_t const&       oam,
+    uint32_t                     oam_generation,
+    Line const&                  out)
+  {
+    if (not snapshot_
+        or snapshot_->vram_generation != vram_generation
+        or snapshot_->oam_generation != oam_generation) {
+      auto snapshot = std::make_shared<Snapshot>();
+      snapshot->vram            = vram;
+      snapshot->oam             = oam;
+      snapshot->vram_generation = vram_generation;
+      snapshot->oam_generation  = oam_generation;
+      snapshot_ = std::move(snapshot);
+    }
+
+    Job job;
+    job.line     = line;
+    job.regs     = regs;
+    job.snapshot = snapshot_;
+    job.out      = out;
+
+    pending_.push_back(std::move(job));
+    if (pending_.size() >= BATCH)
+      flush_();
+  }
+
+  // blocks until every line handed to render() is drawn
+  void wait()
+  {
+    flush_();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    work_done_.wait(lock, [this] { return outstanding_ == 0; });
+  }
+
+private:
+  static constexpr size_t BATCH = 8;
+
+  struct Snapshot
+  {
+    Scanline::vram_t vram;
+    Scanline::oam_t  oam;
+    uint32_t         vram_generation;
+    uint32_t         oam_generation;
+  };
+
+  struct Job
+  {
+    int                             line;
+    Scanline::Registers             regs;
+    std::shared_ptr<Snapshot const> snapshot;
+    Line                            out;
+  };
+
+  void flush_()
+  {
+    if (pending_.empty())
+      return;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      outstanding_ += pending_.size();
+      for (auto& job : pending_)
+        queue_.push_back(std::move(job));
+    }
+    pending_.clear();
+
+    work_ready_.notify_all();
+  }
+
+  void work_()
+  {
+    Scanline scanline;
+
+    for (;;) {
+      Job job;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        work_ready_.wait(lock, [this] { return stop_ or not queue_.empty(); });
+        if (queue_.empty())
+          return;
+
+        job = std::move(queue_.front());
+        queue_.pop_front();
+      }
+
+      auto const& snapshot = *job.snapshot;
+      scanline.render(
+        job.line,
+        job.regs,
+        snapshot.vram,
+        snapshot.oam,
+        VramTiles(snapshot.vram),
+        snapshot.oam_generation,
+        job.out);
+      job.snapshot.reset();
+
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (--outstanding_ == 0)
+        work_done_.notify_all();
+    }
+  }
+
+private:
+  // emulation thread only
+  std::shared_ptr<Snapshot const> snapshot_;
+  std::vector<Job>                pending_;
+
+  std::mutex                      mutex_;
+  std::condition_variable         work_ready_;
+  std::condition_variable         work_done_;
+  std::deque<Job>                 queue_;
+  size_t                          outstanding_ = 0;
+  bool                            stop_        = false;
+
+  std::vector<std::thread>        workers_;
+};
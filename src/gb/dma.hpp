@@ -0,0 +1,51 @@
+#pragma once
+
+#include "types.h"
+
+#include <algorithm>
+#include <array>
+
+// OAM DMA (0xFF46). The whole source page is copied at once when the
+// transfer is started, afterwards the cpu is kept off the bus for the
+// duration of the transfer.
+class DMA
+{
+public:
+  static constexpr int LENGTH   = 0xA0;
+  static constexpr int DURATION = LENGTH * 4; // cycles
+
+  typedef std::array<reg_t, LENGTH> oam_t;
+
+  void power_on()
+  {
+    running_ = false;
+    start_   = 0;
+  }
+
+  // src may be null for pages without backing memory, those read as 0xFF
+  void start(uint64_t now, reg_t const* src, oam_t& oam)
+  {
+    if (src)
+      std::copy_n(src, LENGTH, oam.begin());
+    else
+      oam.fill(0xFF);
+
+    running_ = true;
+    start_   = now;
+  }
+
+  bool is_running(uint64_t now) const
+  {
+    return running_ and (now - start_) < DURATION;
+  }
+
+  template <typename Archive>
+  void state(Archive& archive)
+  {
+    archive(running_, start_);
+  }
+
+private:
+  bool     running_ = false;
+  uint64_t start_   = 0;
+};
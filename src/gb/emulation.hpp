@@ -0,0 +1,246 @@
+#pragma once
+
+#include "gb.hpp"
+#include "pacer.hpp"
+#include "rewind.hpp"
+#include "spsc_queue.hpp"
+#include "triple_buffer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <thread>
+
+// Runs a GB on its own thread, one frame at a time and paced to the
+// refresh rate of the DMG (see FramePacer). Button changes come in
+// through a lock free queue and are applied between frames, completed
+// frames go out through GB::frames(). The GB must not be touched from
+// other threads while it runs, apart from frames().read() and
+// memory().read(). Keeps a rewind history of the frames run.
+class Emulation
+{
+public:
+  // the whole address space as the cpu sees it
+  typedef std::array<reg_t, 0x10000> memory_t;
+
+  Emulation(GB& gb)
+    : gb_(gb)
+  {}
+
+  ~Emulation()
+  {
+    stop();
+  }
+
+  void start()
+  {
+    if (thread_.joinable())
+      return;
+
+    running_.store(true, std::memory_order_release);
+    thread_ = std::thread([this] { run_(); });
+  }
+
+  // returns after the frame in progress
+  void stop()
+  {
+    running_.store(false, std::memory_order_release);
+
+    if (thread_.joinable())
+      thread_.join();
+  }
+
+  // false if the queue is full, the change is lost then
+  bool button(Button button, bool down)
+  {
+    return commands_.push({ button, down });
+  }
+
+  // consumer side of the completed frames
+  Frames::buffer_t& frames()
+  {
+    return gb_.frames();
+  }
+
+  // While enabled, a copy of the memory goes out through memory() with
+  // every rendered frame, for debug views. Costs a read of every address.
+  void memory_view(bool enabled)
+  {
+    memory_view_.store(enabled, std::memory_order_relaxed);
+  }
+
+  // consumer side of the memory copies
+  TripleBuffer<memory_t>& memory()
+  {
+    return memory_;
+  }
+
+  // Runs as fast as the host allows, only rendering a frame per DMG
+  // refresh period of wall time. Takes effect with the next frame.
+  void turbo(bool enabled)
+  {
+    turbo_.store(enabled, std::memory_order_relaxed);
+  }
+
+  bool turbo() const
+  {
+    return turbo_.load(std::memory_order_relaxed);
+  }
+
+  // While enabled, every frame goes back REWIND_STEP frames in the
+  // history (see Rewind) and shows the one after.
+  void rewind(bool enabled)
+  {
+    rewinding_.store(enabled, std::memory_order_relaxed);
+  }
+
+  // Shows the frame that many frames ahead (with the buttons held now)
+  // instead of the current one, to hide the input lag of games that only
+  // react a frame or more after reading the buttons. The frames ahead are
+  // thrown away again, each shown frame costs frames + 1 frames of
+  // emulation and a snapshot. 0 disables it.
+  void run_ahead(int frames)
+  {
+    run_ahead_.store(std::max(0, std::min(frames, MAX_RUN_AHEAD)), std::memory_order_relaxed);
+  }
+
+  // emulated time per wall time, measured over the last half second
+  float speed() const
+  {
+    return speed_.load(std::memory_order_relaxed);
+  }
+
+private:
+  static constexpr uint64_t REWIND_STEP   = 4;
+  static constexpr int      MAX_RUN_AHEAD = 8;
+
+  struct Command
+  {
+    Button button;
+    bool   down;
+  };
+
+  void run_()
+  {
+    typedef FramePacer::clock clock;
+
+    bool render = true;
+    bool turbo  = false;
+
+    auto next_render = clock::now();
+    auto measured    = clock::now();
+    int  frames      = 0;
+
+    pacer_.reset();
+    while (running_.load(std::memory_order_acquire)) {
+      if (rewinding_.load(std::memory_order_relaxed))
+        frame_ = rewind_.seek(gb_, frame_ > REWIND_STEP ? frame_ - REWIND_STEP : 0);
+
+      rewind_.capture(gb_, frame_);
+
+      Command command;
+      while (commands_.pop(command)) {
+        gb_.button(command.button, command.down);
+        rewind_.record(frame_, command.button, command.down);
+      }
+
+      if (turbo_.load(std::memory_order_relaxed)) {
+        auto const now = clock::now();
+        render = now >= next_render;
+        if (render)
+          next_render = now + std::chrono::duration_cast<clock::duration>(FramePacer::frames_t(1));
+
+        run_frame_(render);
+        turbo = true;
+      }
+      else {
+        // the paced schedule starts over after turbo
+        if (turbo) {
+          pacer_.reset();
+          render = true;
+          turbo  = false;
+        }
+
+        run_frame_(render);
+        render = pacer_.wait();
+      }
+
+      ++frame_;
+      ++frames;
+      auto const now = clock::now();
+      if (now - measured >= std::chrono::milliseconds(500)) {
+        speed_.store(
+          std::chrono::duration<float>(FramePacer::frames_t(frames)) / (now - measured),
+          std::memory_order_relaxed);
+        measured = now;
+        frames   = 0;
+      }
+    }
+  }
+
+  // Skipped frames do not run ahead
+  void run_frame_(bool render)
+  {
+    int const ahead = run_ahead_.load(std::memory_order_relaxed);
+    if (ahead == 0 or not render)
+      gb_.run_frame(render);
+    else
+      run_ahead_frame_(ahead);
+
+    if (render and memory_view_.load(std::memory_order_relaxed))
+      publish_memory_();
+  }
+
+  // The frame itself is never rendered with run-ahead, the rendered one
+  // is the last frame ahead.
+  void run_ahead_frame_(int ahead)
+  {
+    gb_.run_frame(false);
+    gb_.save_state(ahead_state_);
+
+    // the frames ahead run again for real later, print their serial
+    // output only then
+    gb_.serial_output(false);
+    for (int i = 1; i <= ahead; ++i)
+      gb_.run_frame(i == ahead);
+    gb_.serial_output(true);
+
+    // cannot fail with a state just saved by the same GB. If it does, the
+    // frames ahead stay and run-ahead is off from here on.
+    auto const error = gb_.load_state(ahead_state_);
+    assert(not error.is_set());
+    if (error.is_set()) {
+      fprintf(stderr, "run-ahead disabled: %s\n", error.text().c_str());
+      run_ahead_.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  void publish_memory_()
+  {
+    auto& memory = memory_.back();
+    for (size_t addr = 0; addr < memory.size(); ++addr)
+      memory[addr] = gb_.mem(addr);
+
+    memory_.publish();
+  }
+
+private:
+  GB& gb_;
+
+  SpscQueue<Command, 64> commands_;
+  FramePacer             pacer_;
+  Rewind                 rewind_;
+  uint64_t               frame_ = 0; // frames run
+  mem_t                  ahead_state_;
+  TripleBuffer<memory_t> memory_;
+
+  std::atomic<bool>  running_     = { false };
+  std::atomic<bool>  turbo_       = { false };
+  std::atomic<bool>  rewinding_   = { false };
+  std::atomic<int>   run_ahead_   = { 0 };
+  std::atomic<bool>  memory_view_ = { false };
+  std::atomic<float> speed_       = { 1.0f };
+  std::thread        thread_;
+};
@@ -8,6 +8,7 @@ public:
   enum class Code {
     None,
     RomNotSupported,
+    StateInvalid,
   };
 
   Error() = default;
@@ -41,6 +42,8 @@ public:
       return "No error";
     case Code::RomNotSupported: 
       return "Rom is not supported.";
+    case Code::StateInvalid:
+      return "State does not match the machine.";
     default:
       return "No error text specified.";
     }
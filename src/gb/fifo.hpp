@@ -0,0 +1,330 @@
+#pragma once
+
+#include "types.h"
+
+#include "mm.hpp"
+#include "pixels.hpp"
+#include "scanline.hpp"
+#include "tiles.hpp"
+
+#include <algorithm>
+#include <array>
+
+// Accurate renderer policy of GR (see ScanlineRenderer): a pixel FIFO
+// clocked every transfer dot. The background fetcher reads the tile
+// map and tile data with the registers of that moment, pixels are
+// mixed with the sprite FIFO and mapped through the palettes as they
+// are shifted out. Mid line SCX/SCY, LCDC and palette writes therefore
+// show up where they happen, and the transfer takes 172 dots plus the
+// fine scroll, 6 dots for starting the window and 6 or more per sprite.
+template <typename Output>
+class FifoRenderer
+{
+  static constexpr int WIDTH = Scanline::WIDTH;
+
+public:
+  void power_on()
+  {
+    window_line_ = 0;
+    window_y_    = false;
+  }
+
+  int start(int line, bool draw, MM const& mm, Output& output)
+  {
+    line_ = line;
+    draw_ = draw;
+    if (draw)
+      out_ = output.line(line);
+
+    // the window line counter and the WY match last a frame, WY is not
+    // compared with the lcd off
+    if (line == 0) {
+      window_line_ = 0;
+      window_y_    = false;
+    }
+    if ((mm.read(0xFF40) & 0x80) and mm.read(0xFF4A) == line)
+      window_y_ = true;
+
+    select_sprites_(mm);
+
+    x_             = 0;
+    discard_       = mm.read(0xFF43) & 0x07;
+    startup_       = 6; // the first fetch is thrown away
+    bg_size_       = 0;
+    bg_pos_        = 0;
+    sprite_colors_.fill(0);
+    fetch_stage_   = 0;
+    fetch_x_       = 0;
+    window_        = false;
+    sprite_dots_   = -1;
+    done_          = false;
+
+    return dot_(mm);
+  }
+
+  int step(int, MM const& mm, Output&)
+  {
+    if (done_)
+      return 0;
+
+    return dot_(mm);
+  }
+
+  // lines are always complete when the transfer ends
+  void wait()
+  {
+  }
+
+private:
+  // one dot of the transfer, returns the dots until the next call
+  int dot_(MM const& mm)
+  {
+    if (startup_ > 0) {
+      --startup_;
+      return 1;
+    }
+
+    reg_t const lcdc = mm.read(0xFF40);
+
+    // a sprite at the current x stops the output until the background
+    // fetch in progress is complete and the sprite is fetched
+    if (sprite_dots_ < 0 and next_sprite_ < sprite_count_ and (lcdc & 0x02)) {
+      int const left = mm.oam()[sprites_[next_sprite_] * 4 + 1] - 8;
+      if (left <= x_)
+        sprite_dots_ = 0;
+    }
+
+    if (sprite_dots_ >= 0) {
+      if (fetch_stage_ < PUSH)
+        fetch_(mm, lcdc);
+      else if (++sprite_dots_ == 6) {
+        fetch_sprite_(mm, lcdc);
+        sprite_dots_ = -1;
+        ++next_sprite_;
+      }
+      return 1;
+    }
+
+    // the window restarts the fetcher with its own tiles
+    if (not window_ and (lcdc & 0x20) and window_y_) {
+      int const wx = mm.read(0xFF4B);
+      if (x_ + 7 == wx or (wx < 7 and x_ == 0)) {
+        window_      = true;
+        fetch_stage_ = 0;
+        fetch_x_     = 0;
+        bg_size_     = 0;
+        discard_     = wx < 7 ? 7 - wx : 0;
+        return 1;
+      }
+    }
+
+    fetch_(mm, lcdc);
+
+    if (bg_size_ == 0)
+      return 1;
+
+    reg_t const color = bg_[bg_pos_++];
+    --bg_size_;
+
+    if (discard_ > 0) {
+      --discard_;
+      return 1;
+    }
+
+    shades_[x_] = mix_(mm, lcdc, color);
+
+    if (++x_ == WIDTH) {
+      if (draw_)
+        out_.write(shades_.data());
+      if (window_)
+        ++window_line_;
+      done_ = true;
+    }
+
+    return 1;
+  }
+
+  // the background fetcher: tile number, low and high data byte in two
+  // dots each, then the push waits for an empty FIFO
+  void fetch_(MM const& mm, reg_t lcdc)
+  {
+    if (fetch_stage_ < PUSH) {
+      switch (fetch_stage_++) {
+      case 1: fetch_map_(mm, lcdc); break;
+      case 3: fetch_lo_ = mm.vram()[data_address_(lcdc) + 0]; break;
+      case 5: fetch_hi_ = mm.vram()[data_address_(lcdc) + 1]; break;
+      }
+      return;
+    }
+
+    if (bg_size_ > 0)
+      return;
+
+    Pixels::decode(fetch_lo_, fetch_hi_, bg_.data());
+    bg_size_     = 8;
+    bg_pos_      = 0;
+    fetch_stage_ = 0;
+    ++fetch_x_;
+  }
+
+  void fetch_map_(MM const& mm, reg_t lcdc)
+  {
+    int map;
+    int tile_x;
+    int y;
+    if (window_) {
+      map    = (lcdc & 0x40) ? 0x1C00 : 0x1800;
+      tile_x = fetch_x_ & 31;
+      y      = window_line_;
+    }
+    else {
+      map    = (lcdc & 0x08) ? 0x1C00 : 0x1800;
+      tile_x = ((mm.read(0xFF43) >> 3) + fetch_x_) & 31;
+      y      = (line_ + mm.read(0xFF42)) & 0xFF;
+    }
+
+    fetch_tile_ = mm.vram()[map + (y / 8) * 32 + tile_x];
+    fetch_y_    = y % 8;
+  }
+
+  int data_address_(reg_t lcdc) const
+  {
+    return Tiles::tile(fetch_tile_, lcdc & 0x10) * 16 + fetch_y_ * 2;
+  }
+
+  // merges a sprite into the sprite FIFO, the pixels already in there
+  // come from sprites with a higher priority
+  void fetch_sprite_(MM const& mm, reg_t lcdc)
+  {
+    auto const& oam = mm.oam();
+    auto const  i   = sprites_[next_sprite_];
+
+    reg_t const s_y = oam[i*4 + 0];
+    reg_t const s_x = oam[i*4 + 1];
+    reg_t const s_n = oam[i*4 + 2];
+    reg_t const c   = oam[i*4 + 3];
+
+    bool const small_sprites = not (lcdc & 0x04);
+    int  const height        = small_sprites ? 8 : 16;
+
+    int const top_y = s_y - 16;
+    int const y     = (c & 0x40) ? (height - 1) - (line_ - top_y) : line_ - top_y;
+    int const tile  = (small_sprites ? s_n : (s_n & 0xFE)) + y / 8;
+
+    // sprites that were selected with another height may not cover the
+    // line anymore
+    if (y < 0 or y >= height)
+      return;
+
+    reg_t const lo = mm.vram()[tile * 16 + (y % 8) * 2 + 0];
+    reg_t const hi = mm.vram()[tile * 16 + (y % 8) * 2 + 1];
+
+    std::array<reg_t, 8> row;
+    if (c & 0x20)
+      Pixels::decode_flipped(lo, hi, row.data());
+    else
+      Pixels::decode(lo, hi, row.data());
+
+    // partly left of the screen
+    int const skip = x_ - (s_x - 8);
+
+    for (int n = 0; n + skip < 8; ++n) {
+      if (sprite_colors_[n] != 0 or row[n + skip] == 0)
+        continue;
+
+      sprite_colors_[n] = row[n + skip];
+      sprite_flags_[n]  = c;
+    }
+  }
+
+  // the shade of the pixel shifted out, with the palettes of this dot
+  reg_t mix_(MM const& mm, reg_t lcdc, reg_t color)
+  {
+    reg_t const sprite = sprite_colors_[0];
+    reg_t const flags  = sprite_flags_[0];
+
+    std::copy(sprite_colors_.begin() + 1, sprite_colors_.end(), sprite_colors_.begin());
+    std::copy(sprite_flags_.begin() + 1, sprite_flags_.end(), sprite_flags_.begin());
+    sprite_colors_[7] = 0;
+
+    if (not (lcdc & 0x01))
+      color = 0;
+
+    if (sprite != 0 and (lcdc & 0x02) and (not (flags & 0x80) or color == 0)) {
+      reg_t const palette = mm.read((flags & 0x10) ? 0xFF49 : 0xFF48);
+      return (palette >> (2*sprite)) & 0x03;
+    }
+
+    return (mm.read(0xFF47) >> (2*color)) & 0x03;
+  }
+
+  // like the oam scan: the first 10 sprites on the line, by x then
+  // oam index. Sprites never shown (x 0 or 168 and more) count but are
+  // not fetched.
+  void select_sprites_(MM const& mm)
+  {
+    auto const& oam    = mm.oam();
+    int  const  height = (mm.read(0xFF40) & 0x04) ? 16 : 8;
+
+    int count = 0;
+    for (int i = 0; i < 40 and count < 10; ++i) {
+      int const top_y = oam[i*4 + 0] - 16;
+      if (line_ >= top_y and line_ < top_y + height)
+        sprites_[count++] = i;
+    }
+
+    std::stable_sort(
+      sprites_.begin(),
+      sprites_.begin() + count,
+      [&oam] (reg_t a, reg_t b) { return oam[a*4 + 1] < oam[b*4 + 1]; });
+
+    sprite_count_ = 0;
+    for (int n = 0; n < count; ++n) {
+      reg_t const s_x = oam[sprites_[n]*4 + 1];
+      if (s_x != 0 and s_x < WIDTH + 8)
+        sprites_[sprite_count_++] = sprites_[n];
+    }
+
+    next_sprite_ = 0;
+  }
+
+private:
+  static constexpr int PUSH = 6; // fetcher stage waiting to push
+
+  typename Output::Line out_;
+
+  int   line_;
+  bool  draw_;
+  bool  done_ = false;
+
+  int   x_;       // next pixel on the line
+  int   discard_; // pixels to drop (fine scroll, window left of x 0)
+  int   startup_;
+
+  std::array<reg_t, Scanline::WIDTH> shades_;
+
+  // background FIFO, it is only refilled when empty
+  std::array<reg_t, 8> bg_;
+  int   bg_size_;
+  int   bg_pos_;
+
+  // sprite FIFO, slot 0 is mixed with the next pixel, color 0 is empty
+  std::array<reg_t, 8> sprite_colors_;
+  std::array<reg_t, 8> sprite_flags_;
+
+  int   fetch_stage_;
+  int   fetch_x_;
+  reg_t fetch_tile_;
+  int   fetch_y_;
+  reg_t fetch_lo_;
+  reg_t fetch_hi_;
+
+  bool  window_;           // the fetcher is on window tiles
+  int   window_line_ = 0;  // window lines drawn this frame
+  bool  window_y_    = false;
+
+  std::array<reg_t, 10> sprites_;
+  int   sprite_count_;
+  int   next_sprite_;
+  int   sprite_dots_;      // -1 without a sprite fetch
+};
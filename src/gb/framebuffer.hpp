@@ -0,0 +1,102 @@
+#pragma once
+
+#include "types.h"
+
+#include "pixels.hpp"
+#include "scanline.hpp"
+
+#include <array>
+#include <cstddef>
+
+// Pixel formats of Framebuffer, with the colors used for shades 0
+// (white) to 3 (black) unless the embedder sets its own.
+struct IndexedFormat // the shade itself, one byte per pixel
+{
+  typedef uint8_t pixel_t;
+  static constexpr std::array<pixel_t, 4> COLORS = {{ 0, 1, 2, 3 }};
+};
+
+struct Gray8Format
+{
+  typedef uint8_t pixel_t;
+  static constexpr std::array<pixel_t, 4> COLORS = {{ 0xFF, 0xAA, 0x55, 0x00 }};
+};
+
+struct RGB565Format
+{
+  typedef uint16_t pixel_t;
+  static constexpr std::array<pixel_t, 4> COLORS = {{ 0xFFFF, 0xAD55, 0x52AA, 0x0000 }};
+};
+
+struct ARGB8888Format
+{
+  typedef uint32_t pixel_t;
+  static constexpr std::array<pixel_t, 4> COLORS =
+    {{ 0xFFFFFFFF, 0xFFAAAAAA, 0xFF555555, 0xFF000000 }};
+};
+
+// Output policy of GR (see Frames) writing every line once, straight to
+// memory owned by the embedder: a locked texture, shared memory, an
+// array of some other language. The format is fixed at compile time.
+// Lines are not drawn before target() is set.
+template <typename Format>
+class Framebuffer
+{
+public:
+  typedef typename Format::pixel_t pixel_t;
+  typedef std::array<pixel_t, 4>   colors_t;
+
+  struct Line
+  {
+    pixel_t*  pixels;
+    colors_t  colors;
+
+    void write(reg_t const* shades) const
+    {
+      if (pixels)
+        Pixels::expand(shades, pixels, Scanline::WIDTH, colors.data());
+    }
+  };
+
+  void power_on()
+  {
+    count_ = 0;
+  }
+
+  // stride is the distance of two lines in bytes
+  void target(void* pixels, ptrdiff_t stride)
+  {
+    pixels_ = static_cast<uint8_t*>(pixels);
+    stride_ = stride;
+  }
+
+  void colors(colors_t const& colors)
+  {
+    colors_ = colors;
+  }
+
+  Line line(int y)
+  {
+    Line line;
+    line.pixels = pixels_ ? reinterpret_cast<pixel_t*>(pixels_ + y * stride_) : nullptr;
+    line.colors = colors_;
+    return line;
+  }
+
+  void completed()
+  {
+    ++count_;
+  }
+
+  // frames completed since power on
+  uint64_t count() const
+  {
+    return count_;
+  }
+
+private:
+  uint8_t*  pixels_ = nullptr;
+  ptrdiff_t stride_ = 0;
+  colors_t  colors_ = Format::COLORS;
+  uint64_t  count_  = 0;
+};
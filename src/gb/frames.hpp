@@ -0,0 +1,182 @@
+#pragma once
+
+#include "types.h"
+
+#include "hash.hpp"
+#include "pixels.hpp"
+#include "scanline.hpp"
+#include "triple_buffer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+// Default output policy of GR: whole frames of shades, optionally also
+// as 32 bit host pixels, handed over through a triple buffer.
+//
+// An output policy provides line(y), the destination of a line in the
+// frame being drawn (a small copyable value with write(shades)), and
+// completed(), called when all lines of a frame are written.
+class Frames
+{
+  static constexpr int WIDTH  = Scanline::WIDTH;
+  static constexpr int HEIGHT = Scanline::HEIGHT;
+
+public:
+  typedef Scanline::screen_t screen_t;
+
+  // host pixels, for shades 0 (white) to 3 (black)
+  typedef std::array<uint32_t, 4>              colors_t;
+  typedef std::vector<uint32_t>                rgba_screen_t;
+
+  // a completed frame, number counts the published frames. hash is the
+  // FrameHash of the shades, 0 without hashing(). rgba stays empty
+  // without rgba(), so the frames only take host pixel memory when they
+  // are used. dirty is set for the lines that differ from the frame
+  // published before (number - 1), a consumer that missed frames has to
+  // redraw everything.
+  struct Frame
+  {
+    screen_t      screen;
+    rgba_screen_t rgba;
+    uint64_t      number;
+    uint64_t      hash;
+    std::array<uint8_t, HEIGHT> dirty;
+
+    bool changed() const
+    {
+      return std::any_of(dirty.begin(), dirty.end(), [] (uint8_t d) { return d != 0; });
+    }
+
+    // calls fn(first line, line count) for each run of changed lines
+    template <typename Fn>
+    void dirty_ranges(Fn&& fn) const
+    {
+      for (int y = 0; y < HEIGHT; ) {
+        if (not dirty[y]) {
+          ++y;
+          continue;
+        }
+
+        int const first = y;
+        while (y < HEIGHT and dirty[y])
+          ++y;
+        fn(first, y - first);
+      }
+    }
+  };
+
+  typedef TripleBuffer<Frame> buffer_t;
+
+  struct Line
+  {
+    reg_t*       screen;
+    uint32_t*    rgba;   // null without rgba()
+    colors_t     colors;
+    reg_t const* last;   // the line in the published frame
+    uint8_t*     dirty;
+
+    void write(reg_t const* shades) const
+    {
+      *dirty = not std::equal(shades, shades + WIDTH, last);
+
+      std::copy_n(shades, WIDTH, screen);
+
+      if (rgba)
+        Pixels::expand(shades, rgba, WIDTH, colors.data());
+    }
+  };
+
+  void power_on()
+  {
+    count_ = 0;
+    clear_();
+  }
+
+  Line line(int y)
+  {
+    auto& frame = frames_.back();
+
+    Line line;
+    line.screen = &frame.screen[y * WIDTH];
+    line.rgba   = rgba_ ? &frame.rgba[y * WIDTH] : nullptr;
+    line.colors = colors_;
+    line.last   = &frames_.published().screen[y * WIDTH];
+    line.dirty  = &frame.dirty[y];
+    return line;
+  }
+
+  void completed()
+  {
+    auto& frame = frames_.back();
+    auto const& last = frames_.published();
+
+    // lines not drawn this frame (lcd switched on late) still hold
+    // whatever the buffer had
+    for (int y = 0; y < HEIGHT; ++y) {
+      if (frame.dirty[y] == UNWRITTEN) {
+        auto const line = frame.screen.begin() + y * WIDTH;
+        frame.dirty[y] = not std::equal(line, line + WIDTH, last.screen.begin() + y * WIDTH);
+      }
+    }
+
+    frame.number = ++count_;
+    frame.hash   = hashing_ ? FrameHash::hash(frame.screen.data(), frame.screen.size()) : 0;
+    frames_.publish();
+
+    frames_.back().dirty.fill(UNWRITTEN);
+  }
+
+  // the last completed frame, only valid on the thread running the gb
+  // and until the next frame completes
+  Frame const& frame() const
+  {
+    return frames_.published();
+  }
+
+  // completed frames for a consumer on another thread
+  buffer_t& frames()
+  {
+    return frames_;
+  }
+
+  // Also write host pixels (any 32 bit format), ready to be copied to a
+  // texture as is. The palettes are already applied to the shades, so
+  // one table covers BGP, OBP0 and OBP1.
+  void rgba(colors_t const& colors)
+  {
+    colors_ = colors;
+    rgba_   = true;
+
+    clear_();
+  }
+
+  // hash every completed frame, for comparing runs
+  void hashing(bool enabled)
+  {
+    hashing_ = enabled;
+  }
+
+private:
+  void clear_()
+  {
+    frames_.for_each([this] (Frame& frame) {
+      frame.screen = screen_t();
+      frame.rgba.assign(rgba_ ? WIDTH * HEIGHT : 0, colors_[0]);
+      frame.number = 0;
+      frame.hash   = 0;
+      frame.dirty.fill(UNWRITTEN);
+    });
+  }
+
+private:
+  static constexpr uint8_t UNWRITTEN = 2;
+
+  buffer_t  frames_;
+  uint64_t  count_  = 0;
+
+  bool      rgba_   = false;
+  colors_t  colors_ = {{ 0 }};
+
+  bool      hashing_ = false;
+};
@@ -5,25 +5,39 @@
 #include "gr.hpp"
 #include "cp.hpp"
 #include "input.hpp"
+#include "state.hpp"
 #include "timer.hpp"
 
 #include <string>
 
 #include <stdio.h>
 
-class GB
+// Output and Renderer are the policies of the ppu, see BasicGR
+template <
+  typename Output,
+  template <typename> class Renderer = ScanlineRenderer>
+class BasicGB
 {
 public:
+  typedef BasicGR<Output, Renderer> gr_t;
   typedef uint8_t            reg_t;
   typedef uint16_t           wide_reg_t;
   typedef std::vector<reg_t> cartridge_t;
   typedef std::vector<reg_t> mem_t;
+  typedef ::rom_t            rom_t;
 
   Error insert_rom(cartridge_t const& cartridge)
   {
     return mm_.insert_rom(cartridge);
   }
 
+  // shares the rom image with every other GB it is inserted into; only
+  // the mapper state and the cartridge ram are kept per instance.
+  Error insert_rom(rom_t const& rom)
+  {
+    return mm_.insert_rom(rom);
+  }
+
   Error load_ram(mem_t const& ram)
   {
     return mm_.load_ram(ram);
@@ -33,10 +47,41 @@ public:
   {
     mm_.power_on();
     cp_.power_on();
+    gr_.power_on();
     t_.power_on();
     in_.power_on();
   }
 
+  // Snapshot of the whole machine (cpu, memory, cartridge ram and mapper,
+  // ppu timing, timer, buttons) between frames, i.e. after run_frame().
+  // Only for loading into a GB running the same rom, see state.hpp.
+  void save_state(mem_t& data)
+  {
+    data.clear();
+
+    StateSaver archive(data);
+    archive(STATE_MAGIC);
+    state_(archive);
+  }
+
+  // on an error the machine is left partly loaded, power it on again
+  Error load_state(mem_t const& data)
+  {
+    StateLoader archive(data);
+
+    uint32_t magic = 0;
+    archive(magic);
+    if (magic != STATE_MAGIC)
+      return Error(Error::Code::StateInvalid);
+
+    state_(archive);
+
+    if (not archive.is_complete())
+      return Error(Error::Code::StateInvalid);
+
+    return Error::NoError();
+  }
+
   void left(bool down) { in_.left(down); }
   void right(bool down) { in_.right(down); }
   void up(bool down) { in_.up(down); }
@@ -47,9 +92,11 @@ public:
   void start(bool down) { in_.start(down); }
   void select(bool down) { in_.select(down); }
 
+  void button(Button button, bool down) { in_.button(button, down); }
+
   reg_t mem(wide_reg_t addr) const
   {
-    return mm_.read(addr);
+    return mm_.read(addr, true);
   }
 
   mem_t ram() const
@@ -67,11 +114,42 @@ public:
     return gr_.height();
   }
 
-  GR::screen_t screen() const
+  // where the frames go, see Framebuffer::target() for example
+  Output& output()
+  {
+    return gr_.output();
+  }
+
+  // the following need Frames as output
+
+  typename gr_t::screen_t screen() const
   {
     return gr_.screen();
   }
 
+  // last completed frame, without a copy; same thread only
+  Frames::Frame const& frame() const
+  {
+    return gr_.frame();
+  }
+
+  // lock free handoff of completed frames to one consumer thread
+  Frames::buffer_t& frames()
+  {
+    return gr_.frames();
+  }
+
+  // see Frames::rgba()
+  void rgba(Frames::colors_t const& colors)
+  {
+    gr_.rgba(colors);
+  }
+
+  Frames::rgba_screen_t const& rgba_screen() const
+  {
+    return gr_.rgba_screen();
+  }
+
   bool is_v_blank_completed() const
   {
     return gr_.lx() == 0 and gr_.ly() == 0;
@@ -83,6 +161,7 @@ public:
       mm_.rom_verified();
     }
 
+    mm_.tick();
     cp_.tick();
     in_.tick();
     t_.tick();
@@ -91,19 +170,65 @@ public:
     // FIXME: remove this serial dbg hack
     if (mm_.read(0xFF02)) {
       mm_.write(0xFF02, 0x00);
-      printf("SERIAL:%c\n", mm_.read(0xFF01));
+      if (serial_output_)
+        printf("SERIAL:%c\n", mm_.read(0xFF01));
     }
   }
 
+  // prints the bytes sent over the serial port (on by default), not part
+  // of the state
+  void serial_output(bool enabled)
+  {
+    serial_output_ = enabled;
+  }
+
+  // renders the lines on that many threads, 0 for inline (default)
+  void render_threads(int count)
+  {
+    gr_.threads(count);
+  }
+
+  // runs until the next frame starts, skipped frames (render false) have
+  // the same timing but leave screen() untouched
+  void run_frame(bool render = true)
+  {
+    gr_.render(render);
+
+    do {
+      tick();
+    } while (not is_v_blank_completed());
+  }
+
   void dbg()
   {
     cp_.dbg();
   }
 
+private:
+  static constexpr uint32_t STATE_MAGIC = 0x59474201;
+
+  // the ppu first, it waits for its render threads before mm changes
+  template <typename Archive>
+  void state_(Archive& archive)
+  {
+    gr_.state(archive);
+    mm_.state(archive);
+    cp_.state(archive);
+    t_.state(archive);
+    in_.state(archive);
+  }
+
 private:
   MM      mm_;
   CP      cp_      = { mm_ };
-  GR      gr_      = { mm_ };
+  gr_t    gr_      = { mm_ };
   Timer   t_       = { mm_ };
   Input   in_      = { mm_ };
+
+  bool    serial_output_ = true;
 };
+
+typedef BasicGB<Frames> GB;
+
+// with the pixel FIFO, for games relying on mid line register writes
+typedef BasicGB<Frames, FifoRenderer> AccurateGB;
@@ -3,295 +3,275 @@
 #include "types.h"
 
 #include "mm.hpp"
-
-class GR
+#include "fifo.hpp"
+#include "frames.hpp"
+#include "renderer.hpp"
+#include "scanline.hpp"
+
+// The output policy decides where finished lines go, see Frames (the
+// default, GR) and Framebuffer. The renderer policy decides how the
+// lines are drawn and how long their transfer takes: ScanlineRenderer
+// (the default) or FifoRenderer. All are resolved at compile time.
+template <
+  typename Output,
+  template <typename> class Renderer = ScanlineRenderer>
+class BasicGR
 {
-  static const reg_t WIDTH  = 160;
-  static const reg_t HEIGHT = 144;
+  static const reg_t WIDTH  = Scanline::WIDTH;
+  static const reg_t HEIGHT = Scanline::HEIGHT;
 
 public:
-  typedef std::array<reg_t, WIDTH*HEIGHT> screen_t;
+  typedef Scanline::screen_t screen_t;
+  typedef Output             output_t;
 
-  GR(MM& mm)
+  BasicGR(MM& mm)
     : mm_(mm)
-    , lx_(0)
-  {}
+  {
+    power_on();
+  }
 
   void power_on()
   {
-    lx_ = 0;
-    screen_  = screen_t();
+    wait_();
+
+    // line 0 starts with its oam scan, so the first frame is a whole one
+    lx_    = 0;
+    ly_    = 0;
+    mode_  = 0x02;
+    next_  = OAM_DOTS;
+    mm_.lcd().mode = mode_;
+    render_frame_ = render_;
+    drawn_ = false;
+    output_.power_on();
+    renderer_.power_on();
   }
 
-  screen_t screen() const
+  // Only the timing, so only complete between frames: a line in transfer
+  // would lose the renderer's progress. The output is not part of it.
+  template <typename Archive>
+  void state(Archive& archive)
   {
-    return screen_;
+    if (Archive::loading)
+      wait_();
+
+    archive(lx_, ly_, mode_, next_, render_frame_, drawn_);
+
+    if (Archive::loading)
+      renderer_.power_on();
   }
 
-  reg_t width() const
+  // for configuring the output between frames, waits for the render
+  // threads
+  Output& output()
   {
-    return WIDTH;
+    wait_();
+    return output_;
   }
 
-  reg_t height() const
+  Output const& output() const
   {
-    return HEIGHT;
+    return output_;
   }
 
-  reg_t lcdc()    const { return mm_.read(0xFF40); }
-  reg_t scy()     const { return mm_.read(0xFF42); }
-  reg_t scx()     const { return mm_.read(0xFF43); }
-  reg_t wy()      const { return mm_.read(0xFF4A); }
-  reg_t wx()      const { return mm_.read(0xFF4B); }
-  reg_t ly()      const { return mm_.read(0xFF44); }
-  reg_t lyc()     const { return mm_.read(0xFF45); }
-  wide_reg_t lx() const { return lx_; }
+  // the rest only exists with Frames as output
 
-  void ly(reg_t val)
+  // the last completed frame, only valid on the thread running the gb
+  // and until the next frame completes
+  auto const& frame() const
   {
-    mm_.write(0xFF44, val, true);
+    return output_.frame();
   }
 
-  void tick()
+  // Completed frames for a consumer on another thread, see TripleBuffer.
+  // Skipped frames and frames with the lcd off are not published.
+  auto& frames()
   {
-    auto v_ly = ly();
-    auto const v_ly_orig = v_ly;
-
-    ++lx_;
-
-    if (lx_ == 450) {
-      ++v_ly;
-      lx_ = 0;
-    }
-
-    if (v_ly == 154) {
-      v_ly = 0;
-    }
-
-    bool mode_entered = false;
-
-    reg_t mode = 0x00;
-    if (v_ly >= 144) {
-      mode = 0x01;
-    }
-    else if (lx() == 360) {
-      mode = 0x02;
-      render_scanline_(v_ly);
-      mode_entered = true;
-    }
-    else if (lx() > 360) {
-      mode = 0x02;
-    }
-    else if (lx() >= 160) {
-      mode = 0x00;
-    }
-    else if (lx() == 0) {
-      mode = 0x03;
-      mode_entered = true;
-      render_background_(lx(), v_ly);
-    }
-    else {
-      mode = 0x03;
-      render_background_(lx(), v_ly);
-    }
-
-    reg_t ly_lyc = (v_ly == lyc()) << 2;
-    reg_t stat = mm_.read(0xFF41) & 0xF8;
-    mm_.write(0xFF41, stat | ly_lyc | mode);
-
-    auto const int_00 = stat & 0x08;
-    auto const int_01 = stat & 0x10;
-    auto const int_10 = stat & 0x20;
-    auto const int_ly = stat & 0x40;
-
-    bool interrupt =
-      (mode == 0x00 and int_00) or
-      (mode == 0x01 and int_01) or
-      (mode == 0x10 and int_10) or
-      (ly_lyc       and int_ly);
-
-    if (mode_entered and interrupt) {
-      mm_.write(0xFF0F, mm_.read(0xFF0F) | 0x02); // LCDC int
-    }
-
-    if (v_ly == 144 and lx() == 0) {
-      mm_.write(0xFF0F, mm_.read(0xFF0F) | 0x01); // vblank
-    }
-
-    if (v_ly != v_ly_orig)
-      ly(v_ly);
+    return output_.frames();
   }
 
-private:
-  reg_t pixel_tile_(
-    reg_t index,
-    int x,
-    int y,
-    bool tds = false,
-    bool x_flip = false,
-    bool y_flip = false) const
+  screen_t screen() const
   {
-    reg_t tile_byte_1 = 0;
-    reg_t tile_byte_2 = 0;
-
-    int const tile_y = y_flip ? (7-y) : y;
-    if (tds) {
-      tile_byte_1 = mm_.read(0x8000 + (index*16) + tile_y*2 + 0);
-      tile_byte_2 = mm_.read(0x8000 + (index*16) + tile_y*2 + 1);
-    }
-    else {
-      tile_byte_1 = mm_.read(0x9000 + (static_cast<int8_t>(index)*16) + y*2 + 0);
-      tile_byte_2 = mm_.read(0x9000 + (static_cast<int8_t>(index)*16) + y*2 + 1);
-    }
-
-    int   const bit         = x_flip ? x : (7 - x);
-    reg_t const pixel_bit_1 = (tile_byte_1 & (1 << bit)) > 0;
-    reg_t const pixel_bit_2 = (tile_byte_2 & (1 << bit)) > 0;
-
-    return (pixel_bit_2 << 1) | pixel_bit_1;
+    return frame().screen;
   }
 
-  void render_scanline_(int line)
+  // see Frames::rgba()
+  template <typename Colors>
+  void rgba(Colors const& colors)
   {
-    auto const v_lcdc = lcdc();
-    if (not (v_lcdc & 0x80))
-      return;
-
-    if (v_lcdc & 0x02)
-       render_sprites_(line);
-
-    if (v_lcdc & 0x20)
-      render_window_(line);
+    output().rgba(colors);
   }
 
-  void render_window_(int line)
+  auto const& rgba_screen() const
   {
-    int const v_wx = wx() - 7;
-    int const v_wy = wy();
-
-    if (wx() > 166 or wy() >= 143 or line < v_wy or (line > v_wy + 144))
-      return;
+    return frame().rgba;
+  }
 
-    for (int x = 0; x < 160; ++x) {
-      if (x < v_wx or x > (v_wx + 166))
-        continue;
+  // Renders the lines on that many threads instead of inline, 0 goes
+  // back to inline. The emulation only records the line registers and
+  // vram/oam snapshots, the frame is complete when vblank starts either
+  // way. ScanlineRenderer only.
+  void threads(int count)
+  {
+    renderer_.threads(count);
+  }
 
-      screen_[line * width() + x] = map_palette_(0xFF47, pixel_window_(x, line));
-    }
+  // Frames started while rendering is off keep all the timing, STAT,
+  // LY and interrupts but generate no pixels; the output keeps the last
+  // rendered frame. Takes effect with the next frame.
+  void render(bool enabled)
+  {
+    render_ = enabled;
   }
 
-  void render_sprites_(int line)
+  reg_t width() const
   {
-    bool const small_sprites = not (lcdc() & 0x04);
-    reg_t sprite_count = 0;
-
-    for (int i = 0; i < 40 and sprite_count < 11; ++i) {
-      auto const oam_addr = 0xFE00 + i*4;
-      reg_t const s_y = mm_.read(oam_addr + 0);
-      reg_t const s_x = mm_.read(oam_addr + 1);
-      reg_t const s_n = mm_.read(oam_addr + 2);
-      reg_t const c   = mm_.read(oam_addr + 3);
-
-      bool const xf   =      c & 0x20;
-      bool const yf   =      c & 0x40;
-      bool const pal  =      c & 0x10;
-      bool const prio = not (c & 0x80);
-
-      if (s_y == 0 or s_x == 0) {
-        continue;
-      }
+    return WIDTH;
+  }
 
-//      int const right_x = s_x;
-      int const left_x  = s_x - 8;
+  reg_t height() const
+  {
+    return HEIGHT;
+  }
 
-      int const bottom_y = small_sprites ? s_y - 9 : s_y-1;
-      int const top_y = s_y - 16;
+  reg_t lcdc()    const { return mm_.read(0xFF40); }
+  reg_t scy()     const { return mm_.read(0xFF42); }
+  reg_t scx()     const { return mm_.read(0xFF43); }
+  reg_t wy()      const { return mm_.read(0xFF4A); }
+  reg_t wx()      const { return mm_.read(0xFF4B); }
+  reg_t ly()      const { return ly_; }
+  reg_t lyc()     const { return mm_.read(0xFF45); }
+  wide_reg_t lx() const { return lx_; }
 
-      if (line < top_y or line > bottom_y)
-        continue;
+  // Only counts dots, the ppu itself runs at the mode boundaries: oam
+  // scan (2) at dot 0, transfer (3) at 80, hblank (0) when the renderer
+  // is done (dot 252 for ScanlineRenderer) and vblank (1) from line 144
+  // on. LY, the mode and the interrupts are only touched there.
+  void tick()
+  {
+    if (++lx_ < next_)
+      return;
 
-      ++sprite_count;
+    step_();
+  }
 
-      for (int x = 0; x < 8; ++x) {
-        auto const screen_x = left_x + x;
-        if (screen_x < 0 or screen_x >= 160)
-          continue;
+private:
+  void step_()
+  {
+    if (lx_ == DOTS_PER_LINE) {
+      lx_ = 0;
+      ly_ = (ly_ + 1) % LINES;
+      line_started_();
+    }
 
-	auto const dot_color =
-	  pixel_tile_(s_n, x, line - top_y, true, xf, yf);
-	if (dot_color == 0)
-	  continue;
+    if (ly_ >= HEIGHT) {
+      if (ly_ == HEIGHT) {
+        publish_();
+        mode_entered_(0x01);
+        mm_.write(0xFF0F, mm_.read(0xFF0F) | 0x01); // vblank
+      }
 
-        auto const new_color =
-	  map_palette_(0xFF48 + pal, dot_color);
+      next_ = DOTS_PER_LINE;
+      return;
+    }
 
-        auto& pixel = screen_[line * width() + left_x+x];
-        if (prio or pixel == 0)
-          pixel = new_color;
+    switch (lx_) {
+    case 0:
+      mode_entered_(0x02);
+      next_ = OAM_DOTS;
+      break;
+    case OAM_DOTS:
+      mode_entered_(0x03);
+      next_ = lx_ + start_transfer_();
+      break;
+    default:
+      if (mode_ == 0x03) {
+        int const dots = renderer_.step(ly_, mm_, output_);
+        if (dots > 0) {
+          next_ = lx_ + dots;
+          break;
+        }
       }
+
+      mode_entered_(0x00);
+      next_ = DOTS_PER_LINE;
+      break;
     }
   }
 
-  void render_background_(int x, int y)
+  // LY and the STAT mode bits are read from MM::lcd(), only updated here
+  void line_started_()
   {
-    auto const v_lcdc = lcdc();
-    if (not (v_lcdc & 0x01) or not (v_lcdc & 0x80))
-      return;
+    mm_.lcd().ly = ly_;
 
-    screen_[y * width() + x] = map_palette_(0xFF47, pixel_background_(x, y));
+    // the coincidence interrupt, the flag itself is evaluated on reads
+    if (ly_ == lyc() and (mm_.read(0xFF41) & 0x40))
+      mm_.write(0xFF0F, mm_.read(0xFF0F) | 0x02); // LCDC int
   }
 
-  reg_t pixel_background_(int x, int y) const
+  void mode_entered_(reg_t mode)
   {
-    bool tile_data_select = (lcdc() & 0x10);
-    bool tile_map_select  = (lcdc() & 0x08);
+    mode_ = mode;
+    mm_.lcd().mode = mode;
 
-    int tile_map_start = tile_map_select == false ? 0x9800 : 0x9C00;
+    reg_t const stat = mm_.read(0xFF41);
 
-    int const background_x = (x + scx()) % 256;
-    int const background_y = (y + scy()) % 256;
+    bool const interrupt =
+      (mode == 0x00 and (stat & 0x08)) or
+      (mode == 0x01 and (stat & 0x10)) or
+      (mode == 0x02 and (stat & 0x20));
 
-    int const tile_x = background_x / 8;
-    int const tile_y = background_y / 8;
+    if (interrupt)
+      mm_.write(0xFF0F, mm_.read(0xFF0F) | 0x02); // LCDC int
+  }
 
-    int const tile_local_x = background_x % 8;
-    int const tile_local_y = background_y % 8;
+  int start_transfer_()
+  {
+    if (ly_ == 0)
+      render_frame_ = render_;
 
-    int const tile_data_table_index = tile_y * 32 + tile_x;
-    int const tile_index = mm_.read(tile_map_start + tile_data_table_index);
+    bool const draw = render_frame_ and (lcdc() & 0x80);
+    drawn_ = drawn_ or draw;
 
-    return pixel_tile_(tile_index, tile_local_x, tile_local_y, tile_data_select, false);
+    return renderer_.start(ly_, draw, mm_, output_);
   }
 
-  reg_t pixel_window_(int x, int y) const
+  void wait_()
   {
-    bool tile_data_select = (lcdc() & 0x10);
-    int tile_map_start = ((lcdc() & 0x40) == 0) ? 0x9800 : 0x9C00;
-
-    int const bg_x = (x - wx() + 6);
-    int const bg_y = (y - wy());
-
-    int const tile_x = bg_x / 8;
-    int const tile_y = bg_y / 8;
+    renderer_.wait();
+  }
 
-    int const tile_local_x = bg_x % 8;
-    int const tile_local_y = bg_y % 8;
+  void publish_()
+  {
+    if (not drawn_)
+      return;
 
-    int const tile_data_table_index = tile_y * 32 + tile_x;
-    int const tile_index = mm_.read(tile_map_start + tile_data_table_index);
+    wait_();
 
-    return pixel_tile_(tile_index, tile_local_x, tile_local_y, tile_data_select);
+    output_.completed();
+    drawn_ = false;
   }
 
-  reg_t map_palette_(wide_reg_t addr, reg_t value)
-  {
-    return (mm_.read(addr) >> (2*value)) & 0x03;
-  }
+private:
+  static constexpr int LINES         = 154;
+  static constexpr int DOTS_PER_LINE = 456;
+  static constexpr int OAM_DOTS      = 80;
 
 private:
   MM&       mm_;
 
   int       lx_;
+  int       ly_;
+  reg_t     mode_;
+  int       next_;  // dot of the next mode change or renderer step
 
-  screen_t  screen_;
+  bool      render_       = true;
+  bool      render_frame_ = true; // render_ latched when line 0 is drawn
+
+  Output    output_;
+  bool      drawn_ = false; // a line of this frame went to the output
+
+  // after output_, render threads are stopped before the frames go away
+  Renderer<Output> renderer_;
 };
+
+typedef BasicGR<Frames> GR;
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "types.h"
+
+#include <array>
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// 64 bit hash of a frame, built like XXH3: eight 64 bit lanes take a
+// 64 byte stripe at a time (multiply of the keyed 32 bit halves plus the
+// neighbouring input), are scrambled every 16 stripes and folded at the
+// end. Not compatible with XXH3 itself, but the SSE2/AVX2 and scalar
+// paths give the same values.
+class FrameHash
+{
+public:
+  static uint64_t hash(void const* data, size_t size)
+  {
+    auto const* bytes = static_cast<uint8_t const*>(data);
+
+    acc_t acc = {{
+      PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3,
+      PRIME64_4, PRIME32_2, PRIME64_5, PRIME32_1 }};
+
+    size_t const stripes = size / STRIPE;
+    for (size_t i = 0; i < stripes; ++i) {
+      accumulate_(acc, bytes + i * STRIPE);
+
+      if (i % STRIPES_PER_BLOCK == STRIPES_PER_BLOCK - 1)
+        scramble_(acc);
+    }
+
+    // the tail as a zero padded stripe
+    if (size % STRIPE) {
+      uint8_t last[STRIPE] = { 0 };
+      std::memcpy(last, bytes + stripes * STRIPE, size % STRIPE);
+      accumulate_(acc, last);
+    }
+
+    uint64_t result = size * PRIME64_1;
+    for (int i = 0; i < LANES; i += 2)
+      result += fold_(acc[i] ^ KEY[i], acc[i + 1] ^ KEY[i + 1]);
+
+    return avalanche_(result);
+  }
+
+private:
+  static constexpr int    LANES             = 8;
+  static constexpr size_t STRIPE            = LANES * 8;
+  static constexpr size_t STRIPES_PER_BLOCK = 16;
+
+  static constexpr uint64_t PRIME32_1 = 0x9E3779B1u;
+  static constexpr uint64_t PRIME32_2 = 0x85EBCA77u;
+  static constexpr uint64_t PRIME32_3 = 0xC2B2AE3Du;
+  static constexpr uint64_t PRIME64_1 = 0x9E3779B185EBCA87ull;
+  static constexpr uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4Full;
+  static constexpr uint64_t PRIME64_3 = 0x165667B19E3779F9ull;
+  static constexpr uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ull;
+  static constexpr uint64_t PRIME64_5 = 0x27D4EB2F165667C5ull;
+
+  typedef std::array<uint64_t, LANES> acc_t;
+
+  static constexpr acc_t KEY = {{
+    0xBE4BA423396CFEB8ull, 0x1CAD21F72C81017Cull,
+    0xDB979083E96DD4DEull, 0x1F67B3B7A4A44072ull,
+    0x78E5C0CC4EE679CBull, 0x2172FFCC7DD05A82ull,
+    0x8E2443F7744608B8ull, 0x4C263A81E69035E0ull }};
+
+  static void accumulate_(acc_t& acc, uint8_t const* stripe)
+  {
+#if defined(__AVX2__)
+    for (int i = 0; i < LANES; i += 4) {
+      __m256i const data = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(stripe + i * 8));
+      __m256i const key  = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(&KEY[i]));
+      __m256i const a    = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(&acc[i]));
+
+      __m256i const keyed   = _mm256_xor_si256(data, key);
+      __m256i const product = _mm256_mul_epu32(keyed, _mm256_srli_epi64(keyed, 32));
+      __m256i const swapped = _mm256_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+
+      _mm256_storeu_si256(
+        reinterpret_cast<__m256i*>(&acc[i]),
+        _mm256_add_epi64(a, _mm256_add_epi64(product, swapped)));
+    }
+#elif defined(__SSE2__)
+    for (int i = 0; i < LANES; i += 2) {
+      __m128i const data = _mm_loadu_si128(reinterpret_cast<__m128i const*>(stripe + i * 8));
+      __m128i const key  = _mm_loadu_si128(reinterpret_cast<__m128i const*>(&KEY[i]));
+      __m128i const a    = _mm_loadu_si128(reinterpret_cast<__m128i const*>(&acc[i]));
+
+      __m128i const keyed   = _mm_xor_si128(data, key);
+      __m128i const product = _mm_mul_epu32(keyed, _mm_srli_epi64(keyed, 32));
+      __m128i const swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+
+      _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(&acc[i]),
+        _mm_add_epi64(a, _mm_add_epi64(product, swapped)));
+    }
+#else
+    uint64_t data[LANES];
+    for (int i = 0; i < LANES; ++i)
+      data[i] = read64_(stripe + i * 8);
+
+    for (int i = 0; i < LANES; ++i) {
+      uint64_t const keyed = data[i] ^ KEY[i];
+      acc[i] += (keyed & 0xFFFFFFFF) * (keyed >> 32) + data[i ^ 1];
+    }
+#endif
+  }
+
+  static void scramble_(acc_t& acc)
+  {
+    for (int i = 0; i < LANES; ++i) {
+      acc[i] ^= acc[i] >> 47;
+      acc[i] ^= KEY[LANES - 1 - i];
+      acc[i] *= PRIME32_1;
+    }
+  }
+
+  static uint64_t fold_(uint64_t a, uint64_t b)
+  {
+    __uint128_t const product = static_cast<__uint128_t>(a) * b;
+    return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+  }
+
+  static uint64_t avalanche_(uint64_t h)
+  {
+    h ^= h >> 37;
+    h *= 0x165667919E3779F9ull;
+    h ^= h >> 32;
+    return h;
+  }
+
+  static uint64_t read64_(uint8_t const* src)
+  {
+    uint64_t value;
+    std::memcpy(&value, src, sizeof(value));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    value = __builtin_bswap64(value);
+#endif
+    return value;
+  }
+};
@@ -3,6 +3,11 @@
 #include "types.h"
 #include "mm.hpp"
 
+enum class Button : uint8_t
+{
+  right, left, up, down, a, b, select, start
+};
+
 class Input
 {
 public:
@@ -80,6 +85,28 @@ public:
   void start(bool down)  { button_changed_ = true; start_ = down;  }
   void select(bool down) { button_changed_ = true; select_ = down; }
 
+  void button(Button button, bool pressed)
+  {
+    switch (button) {
+    case Button::right:  right(pressed);  break;
+    case Button::left:   left(pressed);   break;
+    case Button::up:     up(pressed);     break;
+    case Button::down:   down(pressed);   break;
+    case Button::a:      a(pressed);      break;
+    case Button::b:      b(pressed);      break;
+    case Button::select: select(pressed); break;
+    case Button::start:  start(pressed);  break;
+    }
+  }
+
+  template <typename Archive>
+  void state(Archive& archive)
+  {
+    archive(left_, right_, up_, down_, a_, b_, start_, select_);
+    archive(old_left_, old_right_, old_up_, old_down_, old_a_, old_b_, old_start_, old_select_);
+    archive(button_changed_, old_p_1);
+  }
+
 private:
   MM&   mm_;
 
@@ -1,5 +1,8 @@
 #pragma once
 
+#include "rtc.hpp"
+#include "state.hpp"
+
 class MBC
 {
 public:
@@ -8,6 +11,53 @@ public:
   virtual reg_t read(wide_reg_t addr) const = 0;
   virtual void  write(wide_reg_t addr, reg_t value) = 0;
   virtual std::string name() const = 0;
+  virtual void power_on() {}
+
+  // host address of a dma source page, null if it is not backed
+  virtual reg_t const* data(wide_reg_t addr) const = 0;
+
+  // battery backed state besides the ram, stored after it in the save
+  virtual size_t extra_size() const { return 0; }
+  virtual void   save_extra(mem_t& /*data*/) const {}
+  virtual void   load_extra(reg_t const* /*data*/) {}
+
+  // bank registers and the like for snapshots, see state.hpp
+  virtual void state(StateSaver& /*archive*/) {}
+  virtual void state(StateLoader& /*archive*/) {}
+
+protected:
+  // Wraps bank numbers into the banks present. It is applied when a bank
+  // register is written, so rom_[] and ram_[] accesses need no checks.
+  class Banks
+  {
+  public:
+    Banks(size_t count)
+      : count_(count > 0 ? count : 1)
+      , mask_(1)
+    {
+      while (mask_ < count_)
+        mask_ <<= 1;
+      --mask_;
+    }
+
+    size_t operator()(size_t nr) const
+    {
+      nr &= mask_;
+      return nr < count_ ? nr : nr % count_;  // odd sized roms only
+    }
+
+  private:
+    size_t count_;
+    size_t mask_;
+  };
+
+  static reg_t const* page_(mem_t const& mem, size_t offset)
+  {
+    if (offset + 0xA0 > mem.size())
+      return nullptr;
+
+    return &mem[offset];
+  }
 };
 
 class MBCRomOnly : public MBC
@@ -18,15 +68,21 @@ public:
   {
   }
 
+  // there is no cartridge ram, 0xA000-0xBFFF reads as open bus
   reg_t read(wide_reg_t addr) const override
   {
-    return rom_[addr];
+    return addr < 0x8000 ? rom_[addr] : 0xFF;
   }
 
   void write(wide_reg_t /*addr*/, reg_t /*value*/) override
   {
   }
 
+  reg_t const* data(wide_reg_t addr) const override
+  {
+    return addr < 0x8000 ? page_(rom_, addr) : nullptr;
+  }
+
   std::string name() const override
   {
     return "Rom";
@@ -45,19 +101,20 @@ class MBC1 : public MBC
   };
 
 public:
-  MBC1(mem_t const& rom, mem_t& ram)
+  MBC1(mem_t const& rom, mem_t& ram, size_t rom_banks, size_t ram_banks)
     : mode_(Mode::Rom)
     , low_(1)
     , high_(0)
+    , rom_banks_(rom_banks)
+    , ram_banks_(ram_banks)
     , rom_(rom)
     , ram_(ram)
   {
+    update_banks_();
   }
 
   reg_t read(wide_reg_t addr) const override
   {
-    // FIXME: handle oom access
-
     if (addr < 0x8000)
       return rom_[map_rom_addr_(addr)];
 
@@ -66,23 +123,26 @@ public:
 
   void write(wide_reg_t addr, reg_t value) override
   {
-    if (addr > 0x8000) {
+    if (addr >= 0xA000) {
       ram_[map_ram_addr_(addr)] = value;
       return;
     }
 
     if (addr >= 0x2000 and addr <= 0x3FFF) {
-      low_ = value == 0 ? 1 : value;
+      low_ = (value & 0x1F) == 0 ? 1 : (value & 0x1F);
+      update_banks_();
       return;
     }
 
     if (addr >= 0x4000 and addr <= 0x5FFF) {
       high_ = value & 0x03;
+      update_banks_();
       return;
     }
 
     if (addr >= 0x6000 and addr <= 0x7FFF) {
       mode_ = value == 0 ? Mode::Rom : Mode::Ram;
+      update_banks_();
       return;
     }
   }
@@ -92,7 +152,24 @@ public:
     return "MBC1";
   }
 
+  void state(StateSaver& archive) override { state_(archive); }
+  void state(StateLoader& archive) override { state_(archive); }
+
+  reg_t const* data(wide_reg_t addr) const override
+  {
+    if (addr < 0x8000)
+      return page_(rom_, map_rom_addr_(addr));
+
+    return page_(ram_, map_ram_addr_(addr));
+  }
+
 private:
+  template <typename Archive>
+  void state_(Archive& archive)
+  {
+    archive(mode_, low_, high_, rom_offset_, ram_offset_);
+  }
+
   int rom_bank_nr_() const
   {
     switch (mode_) {
@@ -115,17 +192,23 @@ private:
     }
   }
 
+  void update_banks_()
+  {
+    rom_offset_ = 0x4000 * rom_banks_(rom_bank_nr_());
+    ram_offset_ = 0x2000 * ram_banks_(ram_bank_nr_());
+  }
+
   size_t map_rom_addr_(wide_reg_t addr) const
   {
     if (addr < 0x4000 or addr > 0x7FFF)
       return addr;
 
-    return (addr - 0x4000) + 0x4000 * rom_bank_nr_();
+    return (addr - 0x4000) + rom_offset_;
   }
 
   size_t map_ram_addr_(wide_reg_t addr) const
   {
-    return (addr - 0xA000) + 0x2000 * ram_bank_nr_();
+    return (addr - 0xA000) + ram_offset_;
   }
 
 private:
@@ -133,6 +216,11 @@ private:
   int          low_;
   int          high_;
 
+  Banks const  rom_banks_;
+  Banks const  ram_banks_;
+  size_t       rom_offset_;
+  size_t       ram_offset_;
+
   mem_t const& rom_;
   mem_t&       ram_;
 };
@@ -140,32 +228,31 @@ private:
 class MBC2 : public MBC
 {
 public:
-  MBC2(mem_t const& rom, mem_t& ram)
-    : rom_bank_nr_(1)
+  MBC2(mem_t const& rom, mem_t& ram, size_t rom_banks)
+    : rom_banks_(rom_banks)
     , rom_(rom)
     , ram_(ram)
   {
+    rom_offset_ = 0x4000 * rom_banks_(1);
   }
 
   reg_t read(wide_reg_t addr) const override
   {
-    // FIXME: handle oom access
-
     if (addr < 0x8000)
       return rom_[map_rom_addr_(addr)];
 
-    return ram_[map_ram_addr_(addr)];
+    return ram_[map_ram_addr_(addr)] | 0xF0;
   }
 
   void write(wide_reg_t addr, reg_t value) override
   {
-    if (addr > 0x8000) {
-      ram_[map_ram_addr_(addr)] = value;
+    if (addr >= 0xA000) {
+      ram_[map_ram_addr_(addr)] = value & 0x0F;
       return;
     }
 
     if (addr >= 0x2000 and addr <= 0x3FFF and addr & 0x0100) {
-      rom_bank_nr_ = value == 0 ? 1 : value;
+      rom_offset_ = 0x4000 * rom_banks_((value & 0x0F) == 0 ? 1 : (value & 0x0F));
       return;
     }
   }
@@ -175,33 +262,63 @@ public:
     return "MBC2";
   }
 
+  void state(StateSaver& archive) override { state_(archive); }
+  void state(StateLoader& archive) override { state_(archive); }
+
+  reg_t const* data(wide_reg_t addr) const override
+  {
+    if (addr < 0x8000)
+      return page_(rom_, map_rom_addr_(addr));
+
+    return nullptr; // 4 bit ram, can't be copied as is
+  }
+
 private:
+  template <typename Archive>
+  void state_(Archive& archive)
+  {
+    archive(rom_offset_);
+  }
+
   size_t map_rom_addr_(wide_reg_t addr) const
   {
     if (addr < 0x4000 or addr > 0x7FFF)
       return addr;
 
-    return (addr - 0x4000) + 0x4000 * rom_bank_nr_;
+    return (addr - 0x4000) + rom_offset_;
   }
 
   size_t map_ram_addr_(wide_reg_t addr) const
   {
-    return (addr - 0xA000) + 0x2000;
+    return addr & 0x01FF; // 512 half bytes, mirrored across 0xA000-0xBFFF
   }
 
 private:
-  int          rom_bank_nr_;
+  Banks const  rom_banks_;
+  size_t       rom_offset_;
 
   mem_t const& rom_;
   mem_t&       ram_;
 };
 
-class MBC5 : public MBC
+class MBC3 : public MBC
 {
 public:
-  MBC5(mem_t const& rom, mem_t& ram)
-    : ram_bank_nr_(1)
-    , rom_bank_nr_(0)
+  MBC3(
+    mem_t const& rom,
+    mem_t& ram,
+    size_t rom_banks,
+    size_t ram_banks,
+    uint64_t const& cycle,
+    bool has_rtc)
+    : has_rtc_(has_rtc)
+    , ram_bank_nr_(0)
+    , latch_(0xFF)
+    , rtc_(cycle)
+    , rom_banks_(rom_banks)
+    , ram_banks_(ram_banks)
+    , rom_offset_(0x4000 * rom_banks_(1))
+    , ram_offset_(0)
     , rom_(rom)
     , ram_(ram)
   {
@@ -209,8 +326,142 @@ public:
 
   reg_t read(wide_reg_t addr) const override
   {
-    // FIXME: handle oom access
+    if (addr < 0x8000)
+      return rom_[map_rom_addr_(addr)];
+
+    if (is_rtc_selected_())
+      return rtc_.read(ram_bank_nr_);
+
+    return ram_[map_ram_addr_(addr)];
+  }
+
+  void write(wide_reg_t addr, reg_t value) override
+  {
+    if (addr >= 0xA000) {
+      if (is_rtc_selected_())
+        rtc_.write(ram_bank_nr_, value);
+      else
+        ram_[map_ram_addr_(addr)] = value;
+      return;
+    }
+
+    if (addr >= 0x2000 and addr <= 0x3FFF) {
+      rom_offset_ = 0x4000 * rom_banks_((value & 0x7F) == 0 ? 1 : (value & 0x7F));
+      return;
+    }
+
+    if (addr >= 0x4000 and addr <= 0x5FFF) {
+      ram_bank_nr_ = value;
+      ram_offset_  = 0x2000 * ram_banks_(value & 0x03);
+      return;
+    }
+
+    if (addr >= 0x6000 and addr <= 0x7FFF) {
+      if (latch_ == 0x00 and value == 0x01)
+        rtc_.latch();
+      latch_ = value;
+      return;
+    }
+  }
+
+  std::string name() const override
+  {
+    return "MBC3";
+  }
+
+  void power_on() override
+  {
+    rtc_.power_on();
+  }
+
+  reg_t const* data(wide_reg_t addr) const override
+  {
+    if (addr < 0x8000)
+      return page_(rom_, map_rom_addr_(addr));
+
+    if (is_rtc_selected_())
+      return nullptr;
+
+    return page_(ram_, map_ram_addr_(addr));
+  }
+
+  size_t extra_size() const override
+  {
+    return has_rtc_ ? RTC::SAVE_SIZE : 0;
+  }
+
+  void save_extra(mem_t& data) const override
+  {
+    if (has_rtc_)
+      rtc_.save(data);
+  }
+
+  void load_extra(reg_t const* data) override
+  {
+    if (has_rtc_)
+      rtc_.load(data);
+  }
+
+  void state(StateSaver& archive) override { state_(archive); }
+  void state(StateLoader& archive) override { state_(archive); }
+
+private:
+  template <typename Archive>
+  void state_(Archive& archive)
+  {
+    archive(ram_bank_nr_, latch_, rom_offset_, ram_offset_);
+    rtc_.state(archive);
+  }
+
+  bool is_rtc_selected_() const
+  {
+    return has_rtc_ and ram_bank_nr_ >= 0x08 and ram_bank_nr_ <= 0x0C;
+  }
+
+  size_t map_rom_addr_(wide_reg_t addr) const
+  {
+    if (addr < 0x4000 or addr > 0x7FFF)
+      return addr;
+
+    return (addr - 0x4000) + rom_offset_;
+  }
+
+  size_t map_ram_addr_(wide_reg_t addr) const
+  {
+    return (addr - 0xA000) + ram_offset_;
+  }
+
+private:
+  bool const   has_rtc_;
+  reg_t        ram_bank_nr_;
+  reg_t        latch_;
+  RTC          rtc_;
+
+  Banks const  rom_banks_;
+  Banks const  ram_banks_;
+  size_t       rom_offset_;
+  size_t       ram_offset_;
+
+  mem_t const& rom_;
+  mem_t&       ram_;
+};
+
+class MBC5 : public MBC
+{
+public:
+  MBC5(mem_t const& rom, mem_t& ram, size_t rom_banks, size_t ram_banks)
+    : rom_bank_nr_(1)
+    , rom_banks_(rom_banks)
+    , ram_banks_(ram_banks)
+    , rom_offset_(0x4000 * rom_banks_(1))
+    , ram_offset_(0)
+    , rom_(rom)
+    , ram_(ram)
+  {
+  }
 
+  reg_t read(wide_reg_t addr) const override
+  {
     if (addr < 0x8000)
       return rom_[map_rom_addr_(addr)];
 
@@ -219,18 +470,25 @@ public:
 
   void write(wide_reg_t addr, reg_t value) override
   {
-    if (addr > 0x8000) {
+    if (addr >= 0xA000) {
       ram_[map_ram_addr_(addr)] = value;
       return;
     }
 
-    if (addr >= 0x2000 and addr <= 0x3FFF) {
-      rom_bank_nr_ = value;
+    if (addr >= 0x2000 and addr <= 0x2FFF) {
+      rom_bank_nr_ = (rom_bank_nr_ & 0x100) | value;
+      rom_offset_  = 0x4000 * rom_banks_(rom_bank_nr_);
+      return;
+    }
+
+    if (addr >= 0x3000 and addr <= 0x3FFF) {
+      rom_bank_nr_ = ((value & 0x01) << 8) | (rom_bank_nr_ & 0xFF);
+      rom_offset_  = 0x4000 * rom_banks_(rom_bank_nr_);
       return;
     }
 
     if (addr >= 0x4000 and addr <= 0x5FFF) {
-      ram_bank_nr_ = value & 0x0F;
+      ram_offset_ = 0x2000 * ram_banks_(value & 0x0F);
       return;
     }
   }
@@ -240,24 +498,45 @@ public:
     return "MBC5";
   }
 
+  void state(StateSaver& archive) override { state_(archive); }
+  void state(StateLoader& archive) override { state_(archive); }
+
+  reg_t const* data(wide_reg_t addr) const override
+  {
+    if (addr < 0x8000)
+      return page_(rom_, map_rom_addr_(addr));
+
+    return page_(ram_, map_ram_addr_(addr));
+  }
+
 private:
+  template <typename Archive>
+  void state_(Archive& archive)
+  {
+    archive(rom_bank_nr_, rom_offset_, ram_offset_);
+  }
+
   size_t map_rom_addr_(wide_reg_t addr) const
   {
     if (addr < 0x4000 or addr > 0x7FFF)
       return addr;
 
-    return (addr - 0x4000) + 0x4000 * rom_bank_nr_;
+    return (addr - 0x4000) + rom_offset_;
   }
 
   size_t map_ram_addr_(wide_reg_t addr) const
   {
-    return (addr - 0xA000) + 0x2000 * ram_bank_nr_;
+    return (addr - 0xA000) + ram_offset_;
   }
 
 private:
-  int          ram_bank_nr_;
   int          rom_bank_nr_;
 
+  Banks const  rom_banks_;
+  Banks const  ram_banks_;
+  size_t       rom_offset_;
+  size_t       ram_offset_;
+
   mem_t const& rom_;
   mem_t&       ram_;
 };
@@ -2,6 +2,8 @@
 
 #include "types.h"
 #include "cartridge.hpp"
+#include "dma.hpp"
+#include "tiles.hpp"
 
 #include <array>
 
@@ -13,6 +15,11 @@ class MM
 			return cr_.load(rom);
 		}
 
+		Error insert_rom(rom_t const& rom)
+		{
+			return cr_.load(rom);
+		}
+
 		Error load_ram(mem_t const& ram)
 		{
 			return cr_.load_ram(ram);
@@ -25,12 +32,39 @@ class MM
 
 		void power_on()
 		{
+			// while cycle_ still counts the time run, see RTC::power_on()
 			cr_.power_on();
+			dma_.power_on();
 
 			verified_ = false;
+			cycle_    = 0;
 
-			for (auto& mem : mem_)
-				mem = 0x00;
+			vram_.fill(0x00);
+			tiles_.power_on();
+			++vram_generation_;
+			++oam_generation_;
+			wram_.fill(0x00);
+			oam_.fill(0x00);
+			io_.fill(0x00);
+			hram_.fill(0x00);
+			ie_ = 0x00;
+			lcd_ = Lcd();
+		}
+
+		// The caches (decoded tiles) are rebuilt after loading, and the
+		// generations change so render snapshots are not reused.
+		template <typename Archive>
+		void state(Archive& archive)
+		{
+			archive(verified_, cycle_, lcd_, vram_, wram_, oam_, io_, hram_, ie_);
+			cr_.state(archive);
+			dma_.state(archive);
+
+			if (Archive::loading) {
+				tiles_.update_all(vram_);
+				++vram_generation_;
+				++oam_generation_;
+			}
 		}
 
 		bool is_rom_verified() const
@@ -43,24 +77,96 @@ class MM
 			verified_ = true;
 		}
 
-		reg_t read(wide_reg_t addr) const
+		void tick()
+		{
+			++cycle_;
+		}
+
+		// direct access for the ppu, bypassing the address decoding
+		std::array<reg_t, 0x2000> const& vram() const
+		{
+			return vram_;
+		}
+
+		std::array<reg_t, 0x00A0> const& oam() const
+		{
+			return oam_;
+		}
+
+		Tiles const& tiles() const
+		{
+			return tiles_;
+		}
+
+		// LY and the STAT mode, owned by the ppu which only updates them
+		// when they change; reads of 0xFF41/0xFF44 are answered from here
+		struct Lcd
+		{
+			reg_t ly   = 0;
+			reg_t mode = 0;
+		};
+
+		Lcd& lcd()
+		{
+			return lcd_;
+		}
+
+		// changes whenever oam is written, by the cpu or a dma
+		uint32_t oam_generation() const
+		{
+			return oam_generation_;
+		}
+
+		// changes whenever vram is written
+		uint32_t vram_generation() const
+		{
+			return vram_generation_;
+		}
+
+		// while an oam dma is running the cpu only reaches io and hram,
+		// internal accesses (ppu, debug views) are not affected.
+		bool is_blocked(wide_reg_t addr, bool internal) const
+		{
+			return not internal and addr < 0xFF00 and dma_.is_running(cycle_);
+		}
+
+		reg_t read(wide_reg_t addr, bool internal = false) const
 		{
+			if (is_blocked(addr, internal))
+				return 0xFF;
+
 #ifdef  DO_SWITCHING_SHIT
 			switch (addr) {
-				case 0xe000 ... 0xFE00:
-					addr -= 0x2000;
-					//fallthrough
-				default:
-					return mem_[addr];
 				case 0x0000 ... 0x00ff:
 					if(!verified_){
 						return	dmg_[addr];
 					}
 					//fallthrough
-				case 0x0100 ... 0x8000:
-				case 0xa000 ... 0xBFFF:
+				case 0x0100 ... 0x7FFF:
+				case 0xA000 ... 0xBFFF:
 					return cr_.read(addr);
-
+				case 0x8000 ... 0x9FFF:
+					return vram_[addr - 0x8000];
+				case 0xC000 ... 0xDFFF:
+					return wram_[addr - 0xC000];
+				case 0xE000 ... 0xFDFF: // mirror ram
+					return wram_[addr - 0xE000];
+				case 0xFE00 ... 0xFE9F:
+					return oam_[addr - 0xFE00];
+				case 0xFEA0 ... 0xFEFF: // not usable
+					return 0xFF;
+				case 0xFF41:
+					return stat_();
+				case 0xFF44:
+					return lcd_.ly;
+				case 0xFF00 ... 0xFF40:
+				case 0xFF42 ... 0xFF43:
+				case 0xFF45 ... 0xFF7F:
+					return io_[addr - 0xFF00];
+				case 0xFF80 ... 0xFFFE:
+					return hram_[addr - 0xFF80];
+				default:
+					return ie_;
 			}
 #else 
 
@@ -75,8 +181,32 @@ class MM
 			else if (addr < 0x8000 or (addr >= 0xA000 and addr <= 0xBFFF)) {
 				value = cr_.read(addr);
 			}
+			else if (addr < 0xA000) {
+				value = vram_[addr - 0x8000];
+			}
+			else if (addr < 0xE000) {
+				value = wram_[addr - 0xC000];
+			}
+			else if (addr < 0xFEA0) {
+				value = oam_[addr - 0xFE00];
+			}
+			else if (addr < 0xFF00) {
+				value = 0xFF; // not usable
+			}
+			else if (addr == 0xFF41) {
+				value = stat_();
+			}
+			else if (addr == 0xFF44) {
+				value = lcd_.ly;
+			}
+			else if (addr < 0xFF80) {
+				value = io_[addr - 0xFF00];
+			}
+			else if (addr < 0xFFFF) {
+				value = hram_[addr - 0xFF80];
+			}
 			else {
-				value = mem_[addr];
+				value = ie_;
 			}
 
 			return value;
@@ -89,19 +219,24 @@ class MM
 				value = 0;
 			}
 
-			if (not internal and addr == 0xFF44) { // LY
-				mem_[addr] = 0x00;
+			if (addr == 0xFF44) { // LY, read only, see lcd()
+				return;
+			}
+
+			if (addr == 0xFF41) { // STAT, mode and LYC flag come from lcd_
+				value &= 0x78;
 			}
 
 			if (addr >= 0xE000 and addr < 0xFE00) {
 				addr -= 0x2000; // adjust for mirror ram
 			}
 
+			if (is_blocked(addr, internal))
+				return;
+
 			if (addr == 0xFF46) { // DMA register
-				wide_reg_t src = value << 8;
-				for (reg_t i = 0; i < 40*4; ++i) {
-					write(0xFE00 + i, read(src + i));
-				}
+				dma_.start(cycle_, page_(value << 8), oam_);
+				++oam_generation_;
 			}
 
 			if (addr < 0x0100 and not verified_) {
@@ -110,21 +245,84 @@ class MM
 			else if (addr < 0x8000 or (addr >= 0xA000 and addr <= 0xBFFF)) {
 				cr_.write(addr, value);
 			}
+			else if (addr < 0xA000) {
+				vram_[addr - 0x8000] = value;
+				++vram_generation_;
+				if (addr < 0x9800)
+					tiles_.update(addr - 0x8000, vram_);
+			}
+			else if (addr < 0xE000) {
+				wram_[addr - 0xC000] = value;
+			}
+			else if (addr < 0xFEA0) {
+				oam_[addr - 0xFE00] = value;
+				++oam_generation_;
+			}
+			else if (addr < 0xFF00) {
+				// not usable
+			}
+			else if (addr < 0xFF80) {
+				io_[addr - 0xFF00] = value;
+			}
+			else if (addr < 0xFFFF) {
+				hram_[addr - 0xFF80] = value;
+			}
 			else {
-				mem_[addr] = value;
+				ie_ = value;
 			}
 		}
 
+	private:
+		// enable bits from the cpu, mode from the ppu, LY == LYC flag
+		reg_t stat_() const
+		{
+			return io_[0x41] | ((lcd_.ly == io_[0x45]) << 2) | lcd_.mode;
+		}
+
+		reg_t const* page_(wide_reg_t addr) const
+		{
+			if (addr < 0x8000 or (addr >= 0xA000 and addr <= 0xBFFF))
+				return cr_.data(addr);
+			if (addr < 0xA000)
+				return &vram_[addr - 0x8000];
+			if (addr < 0xE000)
+				return &wram_[addr - 0xC000];
+
+			return &wram_[(addr - 0xE000) & 0x1FFF]; // mirror ram
+		}
+
 	private:
 		bool      verified_ = false;
-		Cartridge cr_;
+		uint64_t  cycle_    = 0;
+		Cartridge cr_       = { cycle_ };
+		DMA       dma_;
+		Lcd       lcd_;
 
-#ifdef WANT_ZEROS_IN_MEM		
-		std::array<reg_t, 0xffff> mem_ {{0}};
+		// only the regions backed by the gb itself; rom and cartridge ram
+		// live in the cartridge. io and hram are kept next to each other
+		// as they are hit by nearly every instruction.
+#ifdef WANT_ZEROS_IN_MEM
+		std::array<reg_t, 0x2000> vram_ {{0}};  // 0x8000-0x9FFF
+		std::array<reg_t, 0x2000> wram_ {{0}};  // 0xC000-0xDFFF
+		std::array<reg_t, 0x00A0> oam_  {{0}};  // 0xFE00-0xFE9F
+		alignas(64)
+		std::array<reg_t, 0x0080> io_   {{0}};  // 0xFF00-0xFF7F
+		std::array<reg_t, 0x007F> hram_ {{0}};  // 0xFF80-0xFFFE
+		reg_t                     ie_   = 0;    // 0xFFFF
 #else
-		std::array<reg_t, 0xffff> mem_;
+		std::array<reg_t, 0x2000> vram_;  // 0x8000-0x9FFF
+		std::array<reg_t, 0x2000> wram_;  // 0xC000-0xDFFF
+		std::array<reg_t, 0x00A0> oam_;   // 0xFE00-0xFE9F
+		alignas(64)
+		std::array<reg_t, 0x0080> io_;    // 0xFF00-0xFF7F
+		std::array<reg_t, 0x007F> hram_;  // 0xFF80-0xFFFE
+		reg_t                     ie_;    // 0xFFFF
 #endif
 
+		Tiles     tiles_;
+		uint32_t  oam_generation_  = 0;
+		uint32_t  vram_generation_ = 0;
+
 		std::array<reg_t, 0x100> const dmg_ = {{
 			0x31, 0xfe, 0xff, 0xaf, 0x21, 0xff, 0x9f, 0x32, 0xcb, 0x7c, 0x20, 0xfb,
 				0x21, 0x26, 0xff, 0x0e, 0x11, 0x3e, 0x80, 0x32, 0xe2, 0x0c, 0x3e, 0xf3,
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <ratio>
+#include <stdint.h>
+#include <thread>
+
+// Paces frames at the DMG refresh rate, 70224 dots at 4194304 Hz
+// (~59.73 Hz). Every deadline is computed from the start and the frame
+// count, so rounding never adds up. Waits sleep until shortly before the
+// deadline and spin (yielding) for the rest; the spin margin follows
+// how late the sleeps wake up.
+//
+// A frame that ends late is caught up by returning right away. When
+// more than a frame behind, the next frame should run without rendering;
+// after a stall longer than MAX_LAG the schedule restarts instead of
+// racing through the missed frames.
+class FramePacer
+{
+public:
+  typedef std::chrono::steady_clock clock;
+
+  // one frame, exactly
+  typedef std::chrono::duration<int64_t, std::ratio<70224, 4194304>> frames_t;
+
+  static constexpr clock::duration MAX_LAG = std::chrono::milliseconds(100);
+
+  void reset()
+  {
+    start_  = clock::now();
+    frames_ = 0;
+  }
+
+  // Waits for the end of the frame just run. Returns false if the next
+  // frame should be skipped (run without rendering) to catch up.
+  bool wait()
+  {
+    ++frames_;
+    auto const deadline = deadline_();
+    auto       now      = clock::now();
+
+    if (now > deadline) {
+      if (now - deadline > MAX_LAG) {
+        ++resyncs_;
+        start_  = now;
+        frames_ = 0;
+        return true;
+      }
+
+      return now - deadline < frames_t(1);
+    }
+
+    if (deadline - now > spin_) {
+      auto const wake = deadline - spin_;
+      std::this_thread::sleep_until(wake);
+
+      // keep the margin at twice the average oversleep
+      now = clock::now();
+      oversleep_ = (oversleep_ * 7 + std::max(now - wake, clock::duration::zero())) / 8;
+      spin_ = std::min(std::max(oversleep_ * 2, MIN_SPIN), MAX_SPIN);
+    }
+
+    while (clock::now() < deadline)
+      std::this_thread::yield();
+
+    return true;
+  }
+
+  // restarts of the schedule after stalls
+  uint64_t resyncs() const
+  {
+    return resyncs_;
+  }
+
+private:
+  clock::time_point deadline_() const
+  {
+    return start_ + std::chrono::duration_cast<clock::duration>(frames_t(frames_));
+  }
+
+private:
+  static constexpr clock::duration MIN_SPIN = std::chrono::microseconds(200);
+  static constexpr clock::duration MAX_SPIN = std::chrono::milliseconds(4);
+
+  clock::time_point start_     = clock::now();
+  int64_t           frames_    = 0;
+
+  clock::duration   spin_      = std::chrono::milliseconds(1);
+  clock::duration   oversleep_ = std::chrono::microseconds(500);
+
+  uint64_t          resyncs_   = 0;
+};
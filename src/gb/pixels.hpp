@@ -0,0 +1,234 @@
+#pragma once
+
+#include "types.h"
+
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSSE3__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Kernels working on 8 (or more) pixels at once. Pixels are one byte
+// each, either a color index 0-3 or a shade after palette mapping. The
+// vector paths are picked at compile time (-march), everything has a
+// scalar fallback.
+class Pixels
+{
+public:
+  // color indices of a tile row from its two bitplane bytes, pixel 0
+  // (bit 7) first. The flipped variant starts with bit 0.
+  static void decode(reg_t lo, reg_t hi, reg_t* dst)
+  {
+    store_(swap_(flipped_(lo, hi)), dst);
+  }
+
+  static void decode_flipped(reg_t lo, reg_t hi, reg_t* dst)
+  {
+    store_(flipped_(lo, hi), dst);
+  }
+
+  // maps n color indices through a BGP/OBP0/OBP1 style palette. n has to
+  // be a multiple of 8.
+  static void map(reg_t const* src, reg_t* dst, int n, reg_t palette)
+  {
+    int i = 0;
+
+#if defined(__AVX2__)
+    __m256i const table = _mm256_broadcastsi128_si256(table_(palette));
+    for (; i + 32 <= n; i += 32) {
+      __m256i const c = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(src + i));
+      _mm256_storeu_si256(
+        reinterpret_cast<__m256i*>(dst + i), _mm256_shuffle_epi8(table, c));
+    }
+#endif
+
+#if defined(__SSE2__)
+    for (; i + 16 <= n; i += 16) {
+      __m128i const c = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), map_(c, palette));
+    }
+#endif
+
+    for (; i < n; i += 8)
+      store_(map_(load_(src + i), palette), dst + i);
+  }
+
+  // n shades (0-3) to 8, 16 or 32 bit host pixels through a 4 entry
+  // table. n has to be a multiple of 8.
+  static void expand(reg_t const* src, uint32_t* dst, int n, uint32_t const* lut)
+  {
+    int i = 0;
+
+#if defined(__AVX2__)
+    __m256i const table = _mm256_castsi128_si256(
+      _mm_loadu_si128(reinterpret_cast<__m128i const*>(lut)));
+    for (; i + 8 <= n; i += 8) {
+      __m256i const s = _mm256_cvtepu8_epi32(
+        _mm_loadl_epi64(reinterpret_cast<__m128i const*>(src + i)));
+      _mm256_storeu_si256(
+        reinterpret_cast<__m256i*>(dst + i), _mm256_permutevar8x32_epi32(table, s));
+    }
+#endif
+
+    for (; i < n; ++i)
+      dst[i] = lut[src[i] & 0x03];
+  }
+
+  static void expand(reg_t const* src, uint16_t* dst, int n, uint16_t const* lut)
+  {
+    int i = 0;
+
+#if defined(__SSSE3__)
+    // low and high bytes looked up separately and interleaved again
+    __m128i const lo = _mm_setr_epi8(
+      lut[0], lut[1], lut[2], lut[3], 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    __m128i const hi = _mm_setr_epi8(
+      lut[0] >> 8, lut[1] >> 8, lut[2] >> 8, lut[3] >> 8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    for (; i + 16 <= n; i += 16) {
+      __m128i const s = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i));
+      __m128i const l = _mm_shuffle_epi8(lo, s);
+      __m128i const h = _mm_shuffle_epi8(hi, s);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 0), _mm_unpacklo_epi8(l, h));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), _mm_unpackhi_epi8(l, h));
+    }
+#endif
+
+    for (; i < n; ++i)
+      dst[i] = lut[src[i] & 0x03];
+  }
+
+  static void expand(reg_t const* src, uint8_t* dst, int n, uint8_t const* lut)
+  {
+    int i = 0;
+
+#if defined(__SSSE3__)
+    __m128i const table = _mm_setr_epi8(
+      lut[0], lut[1], lut[2], lut[3], 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    for (; i + 16 <= n; i += 16) {
+      __m128i const s = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_shuffle_epi8(table, s));
+    }
+#endif
+
+    for (; i < n; ++i)
+      dst[i] = lut[src[i] & 0x03];
+  }
+
+  // draws 8 sprite pixels (color indices) onto the shades in dst. Color 0
+  // is transparent, without priority the sprite only shows where the
+  // background color index is 0.
+  static void merge(
+    reg_t const* sprite,
+    reg_t const* background,
+    reg_t* dst,
+    reg_t palette,
+    bool priority)
+  {
+#if defined(__SSE2__)
+    __m128i const zero = _mm_setzero_si128();
+    __m128i const s    = _mm_loadl_epi64(reinterpret_cast<__m128i const*>(sprite));
+    __m128i const bg   = _mm_loadl_epi64(reinterpret_cast<__m128i const*>(background));
+    __m128i const d    = _mm_loadl_epi64(reinterpret_cast<__m128i const*>(dst));
+
+    __m128i mask = _mm_andnot_si128(_mm_cmpeq_epi8(s, zero), _mm_set1_epi8(-1));
+    if (not priority)
+      mask = _mm_and_si128(mask, _mm_cmpeq_epi8(bg, zero));
+
+    __m128i const out = _mm_or_si128(
+      _mm_and_si128(mask, map_(s, palette)),
+      _mm_andnot_si128(mask, d));
+
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), out);
+#else
+    for (int x = 0; x < 8; ++x) {
+      if (sprite[x] == 0 or (not priority and background[x] != 0))
+        continue;
+
+      dst[x] = (palette >> (2*sprite[x])) & 0x03;
+    }
+#endif
+  }
+
+private:
+  static uint64_t load_(reg_t const* src)
+  {
+    uint64_t value;
+    std::memcpy(&value, src, sizeof(value));
+    return value;
+  }
+
+  static void store_(uint64_t value, reg_t* dst)
+  {
+    std::memcpy(dst, &value, sizeof(value));
+  }
+
+  // bytes in memory order, lowest address in the lowest byte
+  static uint64_t swap_(uint64_t value)
+  {
+    return __builtin_bswap64(value);
+  }
+
+  // bit i of both planes into byte i
+  static uint64_t flipped_(reg_t lo, reg_t hi)
+  {
+#if defined(__BMI2__)
+    uint64_t const value =
+      _pdep_u64(lo, 0x0101010101010101ull) | _pdep_u64(hi, 0x0202020202020202ull);
+#else
+    uint64_t const value = spread_(lo) | (spread_(hi) << 1);
+#endif
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return swap_(value);
+#else
+    return value;
+#endif
+  }
+
+  static uint64_t spread_(reg_t bits)
+  {
+    uint64_t const t = (bits * 0x0101010101010101ull) & 0x8040201008040201ull;
+    return ((t + 0x7F7F7F7F7F7F7F7Full) >> 7) & 0x0101010101010101ull;
+  }
+
+  // SWAR: every byte c of the word becomes (palette >> 2c) & 3
+  static uint64_t map_(uint64_t colors, reg_t palette)
+  {
+    uint64_t const ones = 0x0101010101010101ull;
+    uint64_t const lo   = colors & ones;
+    uint64_t const hi   = (colors >> 1) & ones;
+
+    uint64_t out = 0;
+    for (int c = 0; c < 4; ++c) {
+      uint64_t const match =
+        ((c & 1) ? lo : lo ^ ones) & ((c & 2) ? hi : hi ^ ones);
+      out |= match * ((palette >> (2*c)) & 0x03);
+    }
+
+    return out;
+  }
+
+#if defined(__SSE2__)
+  static __m128i table_(reg_t palette)
+  {
+    return _mm_setr_epi8(
+      palette & 0x03, (palette >> 2) & 0x03, (palette >> 4) & 0x03, (palette >> 6) & 0x03,
+      0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+  }
+
+  static __m128i map_(__m128i colors, reg_t palette)
+  {
+#if defined(__SSSE3__)
+    return _mm_shuffle_epi8(table_(palette), colors);
+#else
+    __m128i out = _mm_setzero_si128();
+    for (int c = 0; c < 4; ++c) {
+      __m128i const match = _mm_cmpeq_epi8(colors, _mm_set1_epi8(c));
+      out = _mm_or_si128(
+        out, _mm_and_si128(match, _mm_set1_epi8((palette >> (2*c)) & 0x03)));
+    }
+    return out;
+#endif
+  }
+#endif
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "types.h"
+
+#include "mm.hpp"
+#include "deferred.hpp"
+#include "scanline.hpp"
+
+#include <memory>
+
+// Fast renderer policy of GR: the whole line is drawn when its transfer
+// starts, with the registers latched at that point, and the transfer
+// always takes 172 dots. Optionally on render threads (Deferred).
+//
+// A renderer policy provides start(), called on the first transfer dot
+// of a visible line, and step(), called when the dots returned by the
+// previous call have passed. Both return the dots until the next call;
+// step() returns 0 on the dot hblank starts.
+template <typename Output>
+class ScanlineRenderer
+{
+public:
+  static constexpr int TRANSFER_DOTS = 172;
+
+  void power_on()
+  {
+    wait();
+    scanline_.invalidate();
+  }
+
+  // draw is false for skipped frames and with the lcd off
+  int start(int line, bool draw, MM const& mm, Output& output)
+  {
+    if (draw)
+      render_(line, mm, output);
+
+    return TRANSFER_DOTS;
+  }
+
+  int step(int, MM const&, Output&)
+  {
+    return 0;
+  }
+
+  // blocks until the render threads are done with every line
+  void wait()
+  {
+    if (deferred_)
+      deferred_->wait();
+  }
+
+  void threads(int count)
+  {
+    deferred_.reset();
+
+    if (count > 0)
+      deferred_.reset(new Deferred<typename Output::Line>(count));
+  }
+
+private:
+  void render_(int line, MM const& mm, Output& output)
+  {
+    Scanline::Registers regs;
+    regs.lcdc = mm.read(0xFF40);
+    regs.scx  = mm.read(0xFF43);
+    regs.scy  = mm.read(0xFF42);
+    regs.wx   = mm.read(0xFF4B);
+    regs.wy   = mm.read(0xFF4A);
+    regs.bgp  = mm.read(0xFF47);
+    regs.obp0 = mm.read(0xFF48);
+    regs.obp1 = mm.read(0xFF49);
+
+    auto const out = output.line(line);
+
+    if (deferred_) {
+      deferred_->render(
+        line, regs,
+        mm.vram(), mm.vram_generation(),
+        mm.oam(), mm.oam_generation(),
+        out);
+    }
+    else {
+      scanline_.render(
+        line, regs,
+        mm.vram(), mm.oam(), mm.tiles(), mm.oam_generation(),
+        out);
+    }
+  }
+
+private:
+  Scanline scanline_;
+  std::unique_ptr<Deferred<typename Output::Line>> deferred_;
+};
@@ -0,0 +1,252 @@
+#pragma once
+
+#include "types.h"
+#include "input.hpp"
+
+#include <algorithm>
+#include <deque>
+
+// Rewind history: a snapshot (GB::save_state()) every interval frames,
+// plus the button changes in between, so any frame in the history can
+// be reached exactly by loading the snapshot before it and replaying
+// the buttons.
+//
+// Only the newest snapshot is kept as is. Each older one is stored as
+// the delta that turns its successor back into it: the XOR of both,
+// with the zero runs (the bulk of it, most memory does not change
+// within a few frames) run length encoded. The oldest entries are
+// dropped once the history outgrows its byte budget.
+class Rewind
+{
+public:
+  Rewind(uint64_t interval = 4, size_t budget = 8 << 20)
+    : interval_(interval)
+    , budget_(budget)
+  {}
+
+  void reset()
+  {
+    entries_.clear();
+    events_.clear();
+    newest_.clear();
+    frame_ = 0;
+    bytes_ = 0;
+  }
+
+  bool empty() const
+  {
+    return newest_.empty();
+  }
+
+  // the frames in the history
+  uint64_t oldest() const
+  {
+    return entries_.empty() ? frame_ : entries_.front().frame;
+  }
+
+  uint64_t newest() const
+  {
+    return frame_;
+  }
+
+  // memory held by the history
+  size_t bytes() const
+  {
+    return bytes_ + newest_.size();
+  }
+
+  // Called before every frame, with the number of frames run so far.
+  // Takes a snapshot on every interval-th frame.
+  template <typename Gb>
+  void capture(Gb& gb, uint64_t frame)
+  {
+    if (frame % interval_ != 0 or (not empty() and frame <= frame_))
+      return;
+
+    gb.save_state(state_);
+
+    if (not empty()) {
+      entries_.push_back({ frame_, mem_t() });
+      encode_(state_, newest_, entries_.back().delta);
+      bytes_ += entries_.back().delta.size();
+    }
+
+    newest_.swap(state_);
+    frame_ = frame;
+
+    trim_();
+  }
+
+  // a button change applied before the given frame
+  void record(uint64_t frame, Button button, bool down)
+  {
+    events_.push_back({ frame, button, down });
+  }
+
+  // Brings gb to the state before the given frame (at least the oldest
+  // one in the history) and returns that frame. The last replayed frame
+  // is rendered. Everything recorded after it is dropped, the history
+  // continues from there.
+  template <typename Gb>
+  uint64_t seek(Gb& gb, uint64_t target)
+  {
+    if (empty())
+      return target;
+
+    while (frame_ > target and not entries_.empty()) {
+      auto const& entry = entries_.back();
+      decode_(entry.delta, newest_);
+      bytes_ -= entry.delta.size();
+      frame_  = entry.frame;
+      entries_.pop_back();
+    }
+
+    target = std::max(target, frame_);
+    gb.load_state(newest_);
+
+    auto event = std::lower_bound(
+      events_.begin(), events_.end(), frame_,
+      [] (Event const& e, uint64_t frame) { return e.frame < frame; });
+
+    for (auto frame = frame_; frame < target; ++frame) {
+      for (; event != events_.end() and event->frame == frame; ++event)
+        gb.button(event->button, event->down);
+
+      gb.run_frame(frame + 1 == target);
+    }
+
+    events_.erase(event, events_.end());
+
+    return target;
+  }
+
+private:
+  struct Entry
+  {
+    uint64_t frame;
+    mem_t    delta;
+  };
+
+  struct Event
+  {
+    uint64_t frame;
+    Button   button;
+    bool     down;
+  };
+
+  void trim_()
+  {
+    while (bytes() > budget_ and not entries_.empty()) {
+      bytes_ -= entries_.front().delta.size();
+      entries_.pop_front();
+    }
+
+    auto const oldest = this->oldest();
+    while (not events_.empty() and events_.front().frame < oldest)
+      events_.pop_front();
+  }
+
+  // delta as pairs of (zero run, literal run) lengths, each followed by
+  // the literal bytes. A state of another size is stored whole.
+  static void encode_(mem_t const& from, mem_t const& to, mem_t& delta)
+  {
+    delta.clear();
+
+    if (from.size() != to.size()) {
+      delta.push_back(WHOLE);
+      delta.insert(delta.end(), to.begin(), to.end());
+      return;
+    }
+
+    delta.push_back(XOR);
+
+    size_t const size = from.size();
+    size_t       i    = 0;
+    while (i < size) {
+      size_t const zeros = i;
+      while (i < size and from[i] == to[i])
+        ++i;
+
+      size_t const literals = i;
+      while (i < size and (from[i] != to[i] or not zero_run_(from, to, i)))
+        ++i;
+
+      put_(delta, literals - zeros);
+      put_(delta, i - literals);
+      for (size_t n = literals; n < i; ++n)
+        delta.push_back(from[n] ^ to[n]);
+    }
+  }
+
+  static void decode_(mem_t const& delta, mem_t& state)
+  {
+    if (delta.empty())
+      return;
+
+    if (delta[0] == WHOLE) {
+      state.assign(delta.begin() + 1, delta.end());
+      return;
+    }
+
+    size_t pos = 1;
+    size_t i   = 0;
+    while (pos < delta.size()) {
+      i += get_(delta, pos);
+
+      size_t const literals = get_(delta, pos);
+      for (size_t n = 0; n < literals; ++n)
+        state[i++] ^= delta[pos++];
+    }
+  }
+
+  // short equal stretches stay in the literal run, a new pair costs more
+  static bool zero_run_(mem_t const& from, mem_t const& to, size_t i)
+  {
+    size_t const end = std::min(i + 4, from.size());
+    for (; i < end; ++i) {
+      if (from[i] != to[i])
+        return false;
+    }
+    return true;
+  }
+
+  // lengths as LEB128
+  static void put_(mem_t& data, size_t value)
+  {
+    do {
+      reg_t const byte = value & 0x7F;
+      value >>= 7;
+      data.push_back(byte | (value ? 0x80 : 0x00));
+    } while (value);
+  }
+
+  static size_t get_(mem_t const& data, size_t& pos)
+  {
+    size_t value = 0;
+    int    shift = 0;
+
+    reg_t byte;
+    do {
+      byte   = data[pos++];
+      value |= static_cast<size_t>(byte & 0x7F) << shift;
+      shift += 7;
+    } while (byte & 0x80);
+
+    return value;
+  }
+
+private:
+  static constexpr reg_t XOR   = 0;
+  static constexpr reg_t WHOLE = 1;
+
+  uint64_t const interval_;
+  size_t   const budget_;
+
+  std::deque<Entry> entries_; // oldest first
+  std::deque<Event> events_;  // by frame
+
+  mem_t    newest_;           // the snapshot at frame_
+  mem_t    state_;            // scratch for capture()
+  uint64_t frame_ = 0;
+  size_t   bytes_ = 0;        // of the deltas
+};
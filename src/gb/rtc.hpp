@@ -0,0 +1,143 @@
+#pragma once
+
+#include "types.h"
+
+#include <array>
+#include <ctime>
+
+// MBC3 real time clock. The clock is not ticked, the registers are
+// derived from a second count taken at some cycle plus the cycles
+// emulated since, and only when the game latches or writes them.
+class RTC
+{
+public:
+  static constexpr uint64_t CLOCK     = 4194304; // cycles per second
+  static constexpr size_t   SAVE_SIZE = 48;
+
+  typedef std::array<reg_t, 5> regs_t; // S, M, H, DL, DH
+
+  RTC(uint64_t const& cycle)
+    : cycle_(cycle)
+  {
+  }
+
+  // Before the cycle count starts over at 0 with the machine. The time
+  // emulated so far is kept, the sub-second part is lost.
+  void power_on()
+  {
+    if (not halted_)
+      seconds_ += elapsed_() / CLOCK;
+    base_cycle_ = 0;
+  }
+
+  void latch()
+  {
+    latched_ = regs_();
+  }
+
+  // reg is the selected register, 0x08-0x0C
+  reg_t read(reg_t reg) const
+  {
+    return latched_[reg - 0x08];
+  }
+
+  void write(reg_t reg, reg_t value)
+  {
+    auto regs = regs_();
+    regs[reg - 0x08] = value;
+
+    // only a write to the seconds resets the sub-second counter
+    auto const phase = not halted_ and reg != 0x08 ? elapsed_() % CLOCK : 0;
+    set_(regs);
+    base_cycle_ = cycle_ - phase;
+  }
+
+  // same layout as other emulators use: current and latched registers
+  // as 32 bit words followed by a 64 bit unix timestamp, little endian
+  void save(mem_t& data) const
+  {
+    auto const put = [&data] (uint64_t value, int bytes) {
+      for (int i = 0; i < bytes; ++i)
+        data.push_back(value >> (8 * i));
+    };
+
+    for (auto reg : regs_())
+      put(reg, 4);
+    for (auto reg : latched_)
+      put(reg, 4);
+    put(std::time(nullptr), 8);
+  }
+
+  void load(reg_t const* data)
+  {
+    auto const get = [&data] (int bytes) {
+      uint64_t value = 0;
+      for (int i = 0; i < bytes; ++i)
+        value |= static_cast<uint64_t>(*data++) << (8 * i);
+      return value;
+    };
+
+    regs_t regs;
+    for (auto& reg : regs)
+      reg = get(4);
+    for (auto& reg : latched_)
+      reg = get(4);
+
+    set_(regs);
+    base_cycle_ = cycle_;
+
+    // the clock kept running while the emulator was not
+    int64_t const saved = get(8);
+    int64_t const now   = std::time(nullptr);
+    if (not halted_ and now > saved)
+      seconds_ += now - saved;
+  }
+
+  template <typename Archive>
+  void state(Archive& archive)
+  {
+    archive(seconds_, base_cycle_, halted_, carry_, latched_);
+  }
+
+private:
+  uint64_t elapsed_() const
+  {
+    return cycle_ > base_cycle_ ? cycle_ - base_cycle_ : 0;
+  }
+
+  regs_t regs_() const
+  {
+    auto const seconds = halted_ ? seconds_ : seconds_ + elapsed_() / CLOCK;
+    auto const days    = seconds / 86400;
+
+    bool const carry = carry_ or days >= 512;
+
+    regs_t regs;
+    regs[0] = seconds % 60;
+    regs[1] = seconds / 60 % 60;
+    regs[2] = seconds / 3600 % 24;
+    regs[3] = days & 0xFF;
+    regs[4] = ((days >> 8) & 0x01) | (halted_ << 6) | (carry << 7);
+
+    return regs;
+  }
+
+  void set_(regs_t const& regs)
+  {
+    uint64_t const days = ((regs[4] & 0x01) << 8) | regs[3];
+
+    seconds_ = regs[0] + regs[1] * 60 + regs[2] * 3600 + days * 86400;
+    halted_  = regs[4] & 0x40;
+    carry_   = regs[4] & 0x80;
+  }
+
+private:
+  uint64_t const& cycle_;
+
+  uint64_t seconds_    = 0; // clock value at base_cycle_
+  uint64_t base_cycle_ = 0;
+  bool     halted_     = false;
+  bool     carry_      = false;
+
+  regs_t   latched_    = {{ 0 }};
+};
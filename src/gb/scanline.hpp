@@ -0,0 +1,197 @@
+#pragma once
+
+#include "types.h"
+
+#include "pixels.hpp"
+#include "sprites.hpp"
+#include "tiles.hpp"
+
+#include <algorithm>
+#include <array>
+
+// Draws one line of the screen from the registers latched for it and
+// a view of vram and oam. Background and window are collected as color
+// indices first, mapped through BGP in one go and then the sprites are
+// merged on top, 8 pixels at a time. Used by GR directly and by the
+// render threads of Deferred.
+class Scanline
+{
+public:
+  static constexpr int WIDTH  = 160;
+  static constexpr int HEIGHT = 144;
+
+  // shades (0-3) of a whole screen
+  typedef std::array<reg_t, WIDTH*HEIGHT> screen_t;
+
+  typedef std::array<reg_t, 0x2000> vram_t;
+  typedef std::array<reg_t, 0x00A0> oam_t;
+
+  // registers a line is rendered with
+  struct Registers
+  {
+    reg_t lcdc;
+    reg_t scx;
+    reg_t scy;
+    reg_t wx;
+    reg_t wy;
+    reg_t bgp;
+    reg_t obp0;
+    reg_t obp1;
+  };
+
+  void invalidate()
+  {
+    sprites_valid_ = false;
+  }
+
+  // tiles is anything with the row() of Tiles. oam_key changes whenever
+  // the oam content does, the per line sprite lists are cached by it.
+  // The finished shades go to out.write(), see the GR output policies.
+  template <typename TileSource, typename Out>
+  void render(
+    int                line,
+    Registers const&   regs,
+    vram_t const&      vram,
+    oam_t const&       oam,
+    TileSource const&  tiles,
+    uint32_t           oam_key,
+    Out const&         out)
+  {
+    colors_.fill(0x00);
+
+    if (regs.lcdc & 0x01) {
+      render_background_(line, regs, vram, tiles);
+
+      if (regs.lcdc & 0x20)
+        render_window_(line, regs, vram, tiles);
+    }
+
+    Pixels::map(&colors_[BORDER], &shades_[BORDER], WIDTH, regs.bgp);
+
+    if (regs.lcdc & 0x02)
+      render_sprites_(line, regs, oam, tiles, oam_key);
+
+    out.write(&shades_[BORDER]);
+  }
+
+private:
+  template <typename TileSource>
+  void render_background_(
+    int line, Registers const& regs, vram_t const& vram, TileSource const& tiles)
+  {
+    bool const tile_data_select = regs.lcdc & 0x10;
+    int  const tile_map_start   = (regs.lcdc & 0x08) ? 0x1C00 : 0x1800;
+
+    int const background_y = (line + regs.scy) % 256;
+
+    reg_t const* const tile_map = &vram[tile_map_start + (background_y / 8) * 32];
+
+    int tile_x = regs.scx / 8;
+    for (int x = BORDER - (regs.scx % 8); x < BORDER + WIDTH; x += 8, ++tile_x) {
+      auto const& row = tiles.row(
+        Tiles::tile(tile_map[tile_x % 32], tile_data_select), background_y % 8);
+
+      std::copy(row.begin(), row.end(), &colors_[x]);
+    }
+  }
+
+  template <typename TileSource>
+  void render_window_(
+    int line, Registers const& regs, vram_t const& vram, TileSource const& tiles)
+  {
+    int const v_wx = regs.wx - 7;
+    int const v_wy = regs.wy;
+
+    if (regs.wx > 166 or regs.wy >= 143 or line < v_wy)
+      return;
+
+    bool const tile_data_select = regs.lcdc & 0x10;
+    int  const tile_map_start   = (regs.lcdc & 0x40) ? 0x1C00 : 0x1800;
+
+    int const window_y = line - v_wy;
+
+    reg_t const* const tile_map = &vram[tile_map_start + (window_y / 8) * 32];
+
+    int tile_x = 0;
+    for (int x = BORDER + v_wx; x < BORDER + WIDTH; x += 8, ++tile_x) {
+      auto const& row =
+        tiles.row(Tiles::tile(tile_map[tile_x], tile_data_select), window_y % 8);
+
+      std::copy(row.begin(), row.end(), &colors_[x]);
+    }
+  }
+
+  template <typename TileSource>
+  void render_sprites_(
+    int line,
+    Registers const& regs,
+    oam_t const& oam,
+    TileSource const& tiles,
+    uint32_t oam_key)
+  {
+    bool const small_sprites = not (regs.lcdc & 0x04);
+    int  const height        = small_sprites ? 8 : 16;
+
+    // the lists only change with oam or the sprite size
+    if (not sprites_valid_
+        or sprites_key_ != oam_key
+        or sprites_height_ != height) {
+      sprites_.build(oam, height);
+      sprites_valid_  = true;
+      sprites_key_    = oam_key;
+      sprites_height_ = height;
+    }
+
+    auto const& list = sprites_.line(line);
+
+    // lowest priority first, so the higher ones are drawn over it
+    for (int n = list.count - 1; n >= 0; --n) {
+      auto const i = list.index[n];
+
+      reg_t const s_y = oam[i*4 + 0];
+      reg_t const s_x = oam[i*4 + 1];
+      reg_t const s_n = oam[i*4 + 2];
+      reg_t const c   = oam[i*4 + 3];
+
+      bool const xf   =      c & 0x20;
+      bool const yf   =      c & 0x40;
+      bool const pal  =      c & 0x10;
+      bool const prio = not (c & 0x80);
+
+      if (s_x == 0 or s_x >= WIDTH + 8)
+        continue;
+
+      int const top_y = s_y - 16;
+
+      int const y    = yf ? (height - 1) - (line - top_y) : line - top_y;
+      int const tile = (small_sprites ? s_n : (s_n & 0xFE)) + y / 8;
+
+      // s_x is the right edge + 1, the border takes the part left of x = 0
+      int const x = BORDER + s_x - 8;
+
+      auto const& row = tiles.row(tile, y % 8, xf);
+
+      Pixels::merge(
+        row.data(),
+        &colors_[x],
+        &shades_[x],
+        pal ? regs.obp1 : regs.obp0,
+        prio);
+    }
+  }
+
+private:
+  // pixels left and right of the screen in the line buffers, catches
+  // the background fine scroll and sprites partially off screen
+  static constexpr int BORDER = 8;
+
+  typedef std::array<reg_t, BORDER + WIDTH + BORDER> line_t;
+
+  line_t    colors_; // background/window color indices
+  line_t    shades_; // after palette mapping, with sprites
+
+  Sprites   sprites_;
+  bool      sprites_valid_  = false;
+  uint32_t  sprites_key_    = 0;
+  int       sprites_height_ = 0;
+};
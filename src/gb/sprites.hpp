@@ -0,0 +1,58 @@
+#pragma once
+
+#include "types.h"
+
+#include <algorithm>
+#include <array>
+
+// Sprites shown on each line, selected in one scan over oam. Like the
+// DMG only the first 10 sprites (in oam order) overlapping a line are
+// taken, ordered by x and then oam index, highest priority first.
+class Sprites
+{
+public:
+  static constexpr int LINES    = 144;
+  static constexpr int PER_LINE = 10;
+
+  typedef std::array<reg_t, 0xA0> oam_t;
+
+  struct List
+  {
+    reg_t count;
+    std::array<reg_t, PER_LINE> index; // into oam, in units of 4 bytes
+  };
+
+  void build(oam_t const& oam, int height)
+  {
+    for (auto& list : lines_)
+      list.count = 0;
+
+    for (int i = 0; i < 40; ++i) {
+      int const top_y = oam[i*4 + 0] - 16;
+
+      int const begin = std::max(top_y, 0);
+      int const end   = std::min(top_y + height, LINES);
+
+      for (int line = begin; line < end; ++line) {
+        auto& list = lines_[line];
+        if (list.count < PER_LINE)
+          list.index[list.count++] = i;
+      }
+    }
+
+    for (auto& list : lines_) {
+      std::stable_sort(
+        list.index.begin(),
+        list.index.begin() + list.count,
+        [&oam] (reg_t a, reg_t b) { return oam[a*4 + 1] < oam[b*4 + 1]; });
+    }
+  }
+
+  List const& line(int line) const
+  {
+    return lines_[line];
+  }
+
+private:
+  std::array<List, LINES> lines_;
+};
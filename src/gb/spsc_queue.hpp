@@ -0,0 +1,46 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <stddef.h>
+
+// Bounded queue from one producer thread to one consumer thread without
+// locks. Size has to be a power of two; push() fails when the queue is
+// full, it never blocks or overwrites.
+template <typename T, size_t Size>
+class SpscQueue
+{
+  static_assert((Size & (Size - 1)) == 0, "Size has to be a power of two");
+
+public:
+  // producer
+  bool push(T const& value)
+  {
+    size_t const tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == Size)
+      return false;
+
+    values_[tail & (Size - 1)] = value;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // consumer
+  bool pop(T& value)
+  {
+    size_t const head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire))
+      return false;
+
+    value = values_[head & (Size - 1)];
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  std::array<T, Size> values_;
+
+  // on their own cache lines, each is written by one side only
+  alignas(64) std::atomic<size_t> head_ = { 0 };
+  alignas(64) std::atomic<size_t> tail_ = { 0 };
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "types.h"
+
+#include <cstring>
+#include <type_traits>
+
+// Machine state as flat bytes, see GB::save_state(). Every component
+// lists its members once in a state() template taking either archive:
+// StateSaver appends them, StateLoader reads them back in the same
+// order. In host byte order and without versioning, so only for the
+// same build and rom (rewind, run-ahead), not for files.
+class StateSaver
+{
+public:
+  StateSaver(mem_t& data)
+    : data_(data)
+  {}
+
+  static constexpr bool loading = false;
+
+  template <typename... T>
+  void operator()(T const&... values)
+  {
+    (put_(values), ...);
+  }
+
+private:
+  template <typename T>
+  void put_(T const& value)
+  {
+    static_assert(std::is_trivially_copyable<T>::value, "plain values only");
+
+    auto const* bytes = reinterpret_cast<reg_t const*>(&value);
+    data_.insert(data_.end(), bytes, bytes + sizeof(T));
+  }
+
+  void put_(mem_t const& value)
+  {
+    put_(static_cast<uint32_t>(value.size()));
+    data_.insert(data_.end(), value.begin(), value.end());
+  }
+
+private:
+  mem_t& data_;
+};
+
+class StateLoader
+{
+public:
+  StateLoader(mem_t const& data)
+    : pos_(data.data())
+    , end_(data.data() + data.size())
+  {}
+
+  static constexpr bool loading = true;
+
+  template <typename... T>
+  void operator()(T&... values)
+  {
+    (get_(values), ...);
+  }
+
+  // everything was read and nothing was missing
+  bool is_complete() const
+  {
+    return ok_ and pos_ == end_;
+  }
+
+private:
+  template <typename T>
+  void get_(T& value)
+  {
+    static_assert(std::is_trivially_copyable<T>::value, "plain values only");
+
+    if (not ok_ or end_ - pos_ < static_cast<ptrdiff_t>(sizeof(T))) {
+      ok_ = false;
+      return;
+    }
+
+    std::memcpy(&value, pos_, sizeof(T));
+    pos_ += sizeof(T);
+  }
+
+  // the size is fixed by the rom, a different one is an error
+  void get_(mem_t& value)
+  {
+    uint32_t size = 0;
+    get_(size);
+
+    if (not ok_ or size != value.size() or end_ - pos_ < static_cast<ptrdiff_t>(size)) {
+      ok_ = false;
+      return;
+    }
+
+    std::memcpy(value.data(), pos_, size);
+    pos_ += size;
+  }
+
+private:
+  reg_t const* pos_;
+  reg_t const* end_;
+  bool         ok_ = true;
+};
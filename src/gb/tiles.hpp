@@ -0,0 +1,85 @@
+#pragma once
+
+#include "types.h"
+#include "pixels.hpp"
+
+#include <array>
+
+// Decoded copy of the 384 tiles at 0x8000-0x97FF, one byte (color 0-3)
+// per pixel, plain and x-flipped. Kept up to date on every vram write so
+// the renderer only copies rows.
+class Tiles
+{
+public:
+  static constexpr int COUNT = 384;
+
+  typedef std::array<reg_t, 8> row_t;
+
+  void power_on()
+  {
+    rows_.fill(row_t());
+    flipped_.fill(row_t());
+  }
+
+  // all tiles again, after vram was replaced
+  void update_all(std::array<reg_t, 0x2000> const& vram)
+  {
+    for (int addr = 0; addr < COUNT * 16; addr += 2)
+      update(addr, vram);
+  }
+
+  // addr is the vram offset that was written
+  void update(wide_reg_t addr, std::array<reg_t, 0x2000> const& vram)
+  {
+    auto const row = addr / 2;
+    auto const lo  = vram[row * 2 + 0];
+    auto const hi  = vram[row * 2 + 1];
+
+    Pixels::decode(lo, hi, rows_[row].data());
+    Pixels::decode_flipped(lo, hi, flipped_[row].data());
+  }
+
+  // tile is the number of the tile from 0x8000 on, y the row within it
+  row_t const& row(int tile, int y, bool x_flip = false) const
+  {
+    return x_flip ? flipped_[tile * 8 + y] : rows_[tile * 8 + y];
+  }
+
+  // tile number of a tile map entry for both addressing modes (LCDC.4)
+  static int tile(reg_t index, bool tile_data_select)
+  {
+    return tile_data_select ? index : 256 + static_cast<int8_t>(index);
+  }
+
+private:
+  std::array<row_t, COUNT * 8> rows_;
+  std::array<row_t, COUNT * 8> flipped_;
+};
+
+// Same rows as Tiles, decoded on demand from a vram copy. For renderers
+// working on a snapshot instead of the live memory.
+class VramTiles
+{
+public:
+  VramTiles(std::array<reg_t, 0x2000> const& vram)
+    : vram_(vram)
+  {
+  }
+
+  Tiles::row_t row(int tile, int y, bool x_flip = false) const
+  {
+    auto const lo = vram_[tile * 16 + y * 2 + 0];
+    auto const hi = vram_[tile * 16 + y * 2 + 1];
+
+    Tiles::row_t row;
+    if (x_flip)
+      Pixels::decode_flipped(lo, hi, row.data());
+    else
+      Pixels::decode(lo, hi, row.data());
+
+    return row;
+  }
+
+private:
+  std::array<reg_t, 0x2000> const& vram_;
+};
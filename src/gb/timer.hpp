@@ -50,6 +50,12 @@ public:
     }
   }
 
+  template <typename Archive>
+  void state(Archive& archive)
+  {
+    archive(cnt_, cnt_2);
+  }
+
 private:
   MM& mm_;
 
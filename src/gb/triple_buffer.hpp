@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <stdint.h>
+
+// Hands the latest of a stream of values (frames) from one producer
+// thread to one consumer thread without locks or copies. The producer
+// fills back() and publishes it, which swaps it with the middle buffer;
+// the consumer swaps the middle buffer with its front buffer when a new
+// one was published. Neither side ever touches the other's buffer.
+template <typename T>
+class TripleBuffer
+{
+public:
+  // producer: the buffer to fill next
+  T& back()
+  {
+    return buffers_[back_];
+  }
+
+  // producer: the most recently published buffer, it stays valid (and
+  // unchanged) until the next publish()
+  T const& published() const
+  {
+    return buffers_[published_];
+  }
+
+  // producer
+  void publish()
+  {
+    published_ = back_;
+    back_ = middle_.exchange(back_ | FRESH, std::memory_order_acq_rel) & INDEX;
+  }
+
+  // consumer: whether something was published since the last read()
+  bool is_fresh() const
+  {
+    return middle_.load(std::memory_order_acquire) & FRESH;
+  }
+
+  // consumer: the newest published buffer, valid until the next read()
+  T const& read()
+  {
+    if (is_fresh())
+      front_ = middle_.exchange(front_, std::memory_order_acq_rel) & INDEX;
+
+    return buffers_[front_];
+  }
+
+  // not thread safe, for (re)initialization only
+  template <typename Fn>
+  void for_each(Fn&& fn)
+  {
+    for (auto& buffer : buffers_)
+      fn(buffer);
+  }
+
+private:
+  static constexpr uint8_t INDEX = 0x03;
+  static constexpr uint8_t FRESH = 0x04;
+
+  std::array<T, 3> buffers_;
+
+  uint8_t              back_      = 0;
+  uint8_t              published_ = 2;
+  std::atomic<uint8_t> middle_    = { 1 };
+  uint8_t              front_     = 2;
+};
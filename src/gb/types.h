@@ -1,5 +1,6 @@
 #pragma once
 
+#include <memory>
 #include <vector>
 #include <stdint.h>
 
@@ -7,3 +8,6 @@ typedef uint8_t            reg_t;
 typedef uint16_t           wide_reg_t;
 typedef std::vector<reg_t> cartridge_t;
 typedef std::vector<reg_t> mem_t;
+
+// read-only rom image, shared between all instances running the same rom
+typedef std::shared_ptr<cartridge_t const> rom_t;
@@ -0,0 +1,136 @@
+// Runs a rom headless and compares the hash of every frame against a
+// recorded golden file (one hex hash per line, the frame count is the
+// number of lines).
+//
+//   yagbe-golden <rom> [<golden>]                 compare
+//   yagbe-golden --record <frames> <rom> [<golden>] record
+//
+// The golden file defaults to <rom>.golden.
+
+#include "gb/gb.hpp"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+bool load_rom(std::string const& path, GB& gb)
+{
+  std::ifstream s(path, std::ios::in | std::ios::binary);
+  if (not s) {
+    fprintf(stderr, "%s: cannot open\n", path.c_str());
+    return false;
+  }
+
+  GB::cartridge_t cart(
+    (std::istreambuf_iterator<char>(s)),
+    std::istreambuf_iterator<char>());
+
+  auto const error = gb.insert_rom(cart);
+  if (error.is_set()) {
+    fprintf(stderr, "%s: %s\n", path.c_str(), error.text().c_str());
+    return false;
+  }
+
+  gb.power_on();
+  return true;
+}
+
+std::vector<uint64_t> run(GB& gb, size_t frames)
+{
+  gb.output().hashing(true);
+
+  std::vector<uint64_t> hashes;
+  hashes.reserve(frames);
+  for (size_t i = 0; i < frames; ++i) {
+    gb.run_frame();
+    hashes.push_back(gb.frame().hash);
+  }
+
+  return hashes;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  bool   record = false;
+  size_t frames = 0;
+
+  int arg = 1;
+  if (argc > 3 and std::strcmp(argv[1], "--record") == 0) {
+    record = true;
+    frames = std::strtoul(argv[2], nullptr, 10);
+    arg    = 3;
+  }
+
+  if (arg >= argc) {
+    fprintf(stderr, "usage: %s [--record <frames>] <rom> [<golden>]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  std::string const rom_path    = argv[arg];
+  std::string const golden_path = arg + 1 < argc ? argv[arg + 1] : rom_path + ".golden";
+
+  GB gb;
+  if (not load_rom(rom_path, gb))
+    return EXIT_FAILURE;
+
+  if (record) {
+    FILE* f = fopen(golden_path.c_str(), "w");
+    if (not f) {
+      fprintf(stderr, "%s: cannot write\n", golden_path.c_str());
+      return EXIT_FAILURE;
+    }
+
+    for (auto hash : run(gb, frames))
+      fprintf(f, "%016" PRIx64 "\n", hash);
+    fclose(f);
+
+    return EXIT_SUCCESS;
+  }
+
+  std::vector<uint64_t> golden;
+  {
+    FILE* f = fopen(golden_path.c_str(), "r");
+    if (not f) {
+      fprintf(stderr, "%s: cannot open\n", golden_path.c_str());
+      return EXIT_FAILURE;
+    }
+
+    uint64_t hash;
+    while (fscanf(f, "%" SCNx64, &hash) == 1)
+      golden.push_back(hash);
+
+    // a line that is not a hash ends the loop before the end of the file
+    bool const complete = feof(f) and not ferror(f);
+    fclose(f);
+
+    if (not complete) {
+      fprintf(stderr, "%s: not a list of hashes\n", golden_path.c_str());
+      return EXIT_FAILURE;
+    }
+    if (golden.empty()) {
+      fprintf(stderr, "%s: no frames\n", golden_path.c_str());
+      return EXIT_FAILURE;
+    }
+  }
+
+  auto const hashes = run(gb, golden.size());
+  for (size_t i = 0; i < golden.size(); ++i) {
+    if (hashes[i] != golden[i]) {
+      fprintf(stderr, "%s: frame %zu differs (%016" PRIx64 ", expected %016" PRIx64 ")\n",
+        rom_path.c_str(), i, hashes[i], golden[i]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  printf("%s: %zu frames match\n", rom_path.c_str(), golden.size());
+  return EXIT_SUCCESS;
+}
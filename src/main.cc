@@ -1,6 +1,7 @@
 #include <SDL2/SDL.h>
 
 #include "gb/gb.hpp"
+#include "gb/emulation.hpp"
 #include "ui-sdl2/ui.hpp"
 
 #include <iostream>
@@ -14,10 +15,24 @@
 
 int main(int argc, char** argv)
 {
-	if (argc < 2)
+	// yagbe [--turbo] [--run-ahead <frames>] <rom>
+	bool turbo     = false;
+	int  run_ahead = 0;
+	int  arg       = 1;
+	for (; arg < argc - 1; ++arg) {
+		std::string const option = argv[arg];
+		if (option == "--turbo")
+			turbo = true;
+		else if (option == "--run-ahead" and arg + 2 < argc)
+			run_ahead = std::atoi(argv[++arg]);
+		else
+			break;
+	}
+
+	if (argc <= arg)
 		return EXIT_FAILURE;
 
-	std::string const rom_path = argv[1];
+	std::string const rom_path = argv[arg];
 	std::string const sav_path = rom_path + ".sav"; // FIXME do it properly
 
 	std::ifstream s_cart(
@@ -48,27 +63,16 @@ int main(int argc, char** argv)
 	gb.load_ram(sav);
 	gb.power_on();
 
-	UiSDL ui(gb, 3, false, false);
-
-	//int frame = 0;
-	auto start = std::chrono::steady_clock::now();
-	while(ui.is_running()) {
+	Emulation emu(gb);
+	UiSDL ui(gb, emu, 3, false, false);
 
-		do {
-			gb.tick();
-		} while(not gb.is_v_blank_completed());
+	// the gb runs on its own thread, sdl stays on this one
+	emu.turbo(turbo);
+	emu.run_ahead(run_ahead);
+	emu.start();
+	while(ui.is_running())
 		ui.tick();
-
-		auto const end = std::chrono::steady_clock::now();
-		auto const delta = end - start;
-		auto const delta_ms =
-			std::chrono::duration_cast<std::chrono::milliseconds>(delta).count();
-		auto const sleep = static_cast<unsigned long>((1000.0/60.0)-delta_ms); // FIXME should be 60
-		start = end + std::chrono::milliseconds(sleep);
-
-		if (sleep > 0)
-			std::this_thread::sleep_for(std::chrono::milliseconds(sleep));
-	}
+	emu.stop();
 
 	std::ofstream s_sav_out(
 			sav_path,
@@ -0,0 +1,95 @@
+// Relative jumps take 12 cycles when taken and 8 when not, JR r8 is
+// always taken. Runs the cpu alone over a few jumps to the next
+// instruction and compares the time each took with that of a NOP.
+
+#include "gb/mm.hpp"
+#include "gb/cp.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+struct Step
+{
+  reg_t       op;
+  int         cycles;
+  char const* name;
+};
+
+// the jumps all go to the next instruction
+Step const steps[] = {
+  { 0x00,  4, "nop"              },
+  { 0xAF,  4, "xor a"            }, // z, nc
+  { 0x28, 12, "jr z (taken)"     },
+  { 0x20,  8, "jr nz (not taken)"},
+  { 0x30, 12, "jr nc (taken)"    },
+  { 0x38,  8, "jr c (not taken)" },
+  { 0x3C,  4, "inc a"            }, // nz
+  { 0x37,  4, "scf"              }, // c
+  { 0x20, 12, "jr nz (taken)"    },
+  { 0x28,  8, "jr z (not taken)" },
+  { 0x38, 12, "jr c (taken)"     },
+  { 0x30,  8, "jr nc (not taken)"},
+  { 0x18, 12, "jr"               },
+  { 0x00,  4, "nop"              },
+};
+
+bool has_operand(reg_t op)
+{
+  return op == 0x18 or op == 0x20 or op == 0x28 or op == 0x30 or op == 0x38;
+}
+
+// ticks until the cpu starts the next instruction
+int run(CP& cp)
+{
+  int ticks = 0;
+  do {
+    ++ticks;
+  } while (not cp.tick());
+  return ticks;
+}
+
+}
+
+int main()
+{
+  mem_t cart(0x8000, 0x00);
+  cart[0x0147] = 0x00; // rom only
+  cart[0x0148] = 0x00; // 32KB
+
+  wide_reg_t addr = 0x0100;
+  for (auto const& step : steps) {
+    cart[addr++] = step.op;
+    if (has_operand(step.op))
+      cart[addr++] = 0x00;
+  }
+
+  MM mm;
+  auto const error = mm.insert_rom(cart);
+  if (error.is_set()) {
+    fprintf(stderr, "insert_rom: %s\n", error.text().c_str());
+    return EXIT_FAILURE;
+  }
+
+  CP cp(mm);
+  mm.power_on();
+  cp.power_on();
+
+  // starts the first nop, the ticks of a step are counted from its start
+  // to the start of the next one
+  run(cp);
+
+  int const overhead = run(cp) - steps[0].cycles;
+
+  bool ok = true;
+  for (size_t i = 1; i + 1 < sizeof(steps) / sizeof(steps[0]); ++i) {
+    int const cycles = run(cp) - overhead;
+    if (cycles != steps[i].cycles) {
+      fprintf(stderr, "%s: %d cycles, expected %d\n", steps[i].name, cycles, steps[i].cycles);
+      ok = false;
+    }
+  }
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,30 @@
+// Saving the ram of a GB without a (supported) rom, as main does after a
+// failed load, returns nothing instead of touching the missing mapper.
+
+#include "gb/gb.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+
+int main()
+{
+  GB gb;
+  if (not gb.ram().empty()) {
+    fprintf(stderr, "ram without a rom\n");
+    return EXIT_FAILURE;
+  }
+
+  GB::cartridge_t cart(0x8000, 0x00);
+  cart[0x0147] = 0xFF; // unsupported mapper
+  if (not gb.insert_rom(cart).is_set()) {
+    fprintf(stderr, "unsupported mapper accepted\n");
+    return EXIT_FAILURE;
+  }
+
+  if (not gb.ram().empty()) {
+    fprintf(stderr, "ram after a failed load\n");
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
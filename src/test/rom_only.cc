@@ -0,0 +1,31 @@
+// A 32KB rom only cartridge has no ram: 0xA000-0xBFFF reads as 0xFF
+// and stays within the rom image (build with ASan to catch overruns).
+
+#include "gb/gb.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+
+int main()
+{
+  GB::cartridge_t cart(0x8000, 0x00);
+  cart[0x0147] = 0x00; // rom only
+  cart[0x0148] = 0x00; // 32KB
+
+  GB gb;
+  auto const error = gb.insert_rom(cart);
+  if (error.is_set()) {
+    fprintf(stderr, "insert_rom: %s\n", error.text().c_str());
+    return EXIT_FAILURE;
+  }
+  gb.power_on();
+
+  for (wide_reg_t addr = 0xA000; addr <= 0xBFFF; ++addr) {
+    if (gb.mem(addr) != 0xFF) {
+      fprintf(stderr, "0x%04X reads 0x%02X, expected 0xFF\n", addr, gb.mem(addr));
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,64 @@
+// The MBC3 clock keeps counting from a loaded save after the machine is
+// powered on, which starts the cycle count over, and keeps the time run
+// before a power cycle.
+
+#include "gb/rtc.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+namespace {
+
+// all registers 0 except the seconds, saved now
+mem_t save(reg_t seconds)
+{
+  mem_t data;
+  auto const put = [&data] (uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i)
+      data.push_back(value >> (8 * i));
+  };
+
+  for (int reg = 0; reg < 10; ++reg)
+    put(reg == 0 ? seconds : 0, 4);
+  put(std::time(nullptr), 8);
+
+  return data;
+}
+
+bool expect(RTC& rtc, int seconds, char const* what)
+{
+  rtc.latch();
+  if (rtc.read(0x08) == seconds)
+    return true;
+
+  fprintf(stderr, "%s: %d seconds, expected %d\n", what, rtc.read(0x08), seconds);
+  return false;
+}
+
+}
+
+int main()
+{
+  uint64_t cycle = 0;
+  RTC      rtc(cycle);
+
+  // loaded into a machine that ran for a while, then powered on
+  cycle = 100 * RTC::CLOCK;
+  auto const data = save(10);
+  rtc.load(data.data());
+  rtc.power_on();
+  cycle = 0;
+
+  cycle += 2 * RTC::CLOCK;
+  bool ok = expect(rtc, 12, "after load");
+
+  // power cycled
+  rtc.power_on();
+  cycle = 0;
+
+  cycle += 3 * RTC::CLOCK;
+  ok = expect(rtc, 15, "after power on") and ok;
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,15 +1,23 @@
 #pragma once
 
 #include "../gb/gb.hpp"
+#include "../gb/emulation.hpp"
 
 #include <SDL2/SDL.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <thread>
 
 class UiSDL
 {
 public:
-  UiSDL(GB& gb, int scale, bool memory, bool tiles)
+  // configures the output of gb, before emu is started
+  UiSDL(GB& gb, Emulation& emu, int scale, bool memory, bool tiles)
     : _gb(gb)
+    , _emu(emu)
     , _scale(scale)
     , _refresh(true)
   {
@@ -24,6 +32,10 @@ public:
       _init_tile_1();
       _init_tile_2();
     }
+
+    // the debug views draw the copies of the memory the emulation thread
+    // hands out, the GB itself is off limits while it runs
+    _emu.memory_view(memory or tiles);
   }
 
   ~UiSDL()
@@ -34,6 +46,7 @@ public:
     SDL_DestroyWindow(_tile_win);
     SDL_DestroyRenderer(_mem_ren);
     SDL_DestroyWindow(_mem_win);
+    SDL_DestroyTexture(_main_tex);
     SDL_DestroyRenderer(_main_ren);
     SDL_DestroyWindow(_main_win);
     SDL_Quit();
@@ -44,66 +57,96 @@ public:
     return _running;
   }
 
+  // Handles the events and presents the newest frame of the emulation
+  // thread, if there is one, along with the memory at its end in the
+  // debug views.
   void tick()
   {
-    if (_gb.is_v_blank_completed()) {
-      SDL_Event event;
-      while(SDL_PollEvent(&event)) {
-        switch(event.type) {
-        case SDL_KEYDOWN:
-          switch (event.key.keysym.sym) {
-          case SDLK_LEFT:  _gb.left(true); break;
-
-          case SDLK_RIGHT: _gb.right(true); break;
-          case SDLK_UP:    _gb.up(true); break;
-          case SDLK_DOWN:  _gb.down(true); break;
-
-          case SDLK_a:  _gb.a(true); break;
-          case SDLK_s:  _gb.b(true); break;
-          case SDLK_y:  _gb.select(true); break;
-          case SDLK_x:  _gb.start(true); break;
-          }
-          break;
-        case SDL_KEYUP:
-          switch (event.key.keysym.sym) {
-          case SDLK_LEFT:  _gb.left(false); break;
-          case SDLK_RIGHT: _gb.right(false); break;
-          case SDLK_UP:    _gb.up(false); break;
-          case SDLK_DOWN:  _gb.down(false); break;
-
-          case SDLK_a:  _gb.a(false); break;
-          case SDLK_s:  _gb.b(false); break;
-          case SDLK_y:  _gb.select(false); break;
-          case SDLK_x:  _gb.start(false); break;
-          }
-          break;
-        case SDL_QUIT:
-          _running= false;
-          break;
+    bool present = _refresh;
+
+    SDL_Event event;
+    while(SDL_PollEvent(&event)) {
+      Button button;
+      switch(event.type) {
+      case SDL_KEYDOWN:
+        if (_button(event.key.keysym.sym, button))
+          _emu.button(button, true);
+
+        // fast forward, rewind while held
+        if (event.key.keysym.sym == SDLK_TAB and not event.key.repeat)
+          _emu.turbo(not _emu.turbo());
+        if (event.key.keysym.sym == SDLK_BACKSPACE)
+          _emu.rewind(true);
+
+        // integer or aspect correct scaling of the main window
+        if (event.key.keysym.sym == SDLK_i) {
+          _integer_scale = not _integer_scale;
+          SDL_RenderSetIntegerScale(_main_ren, _integer_scale ? SDL_TRUE : SDL_FALSE);
+          present = true;
         }
+        break;
+      case SDL_KEYUP:
+        if (_button(event.key.keysym.sym, button))
+          _emu.button(button, false);
+        if (event.key.keysym.sym == SDLK_BACKSPACE)
+          _emu.rewind(false);
+        break;
+      case SDL_WINDOWEVENT:
+        present = true;
+        break;
+      case SDL_QUIT:
+        _running= false;
+        break;
       }
+    }
 
-      if (_main_ren) {
-        _render_main(_main_ren, _gb);
-        SDL_RenderPresent(_main_ren);
-      }
+    if (not present and not _emu.frames().is_fresh()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      return;
+    }
+
+    if (_main_ren) {
+      _render_main(_main_ren, _emu.frames().read());
+      SDL_RenderPresent(_main_ren);
+      _update_title();
+    }
+
+    if (_mem_ren or _tile_ren) {
+      auto const& memory = _emu.memory().read();
 
       if (_mem_ren) {
-        _render_memory(_mem_ren, _gb);
+        _render_memory(_mem_ren, memory);
         SDL_RenderPresent(_mem_ren);
       }
 
       if (_tile_ren) {
-        _render_tiles(_tile_ren, _gb, _tile_pattern_1_start);
+        _render_tiles(_tile_ren, memory, _tile_pattern_1_start);
         SDL_RenderPresent(_tile_ren);
 
-        _render_tiles(_tile2_ren, _gb, _tile_pattern_2_start);
+        _render_tiles(_tile2_ren, memory, _tile_pattern_2_start);
         SDL_RenderPresent(_tile2_ren);
       }
     }
   }
 
 private:
+  static bool _button(SDL_Keycode key, Button& button)
+  {
+    switch (key) {
+    case SDLK_LEFT:  button = Button::left;   return true;
+    case SDLK_RIGHT: button = Button::right;  return true;
+    case SDLK_UP:    button = Button::up;     return true;
+    case SDLK_DOWN:  button = Button::down;   return true;
+
+    case SDLK_a:     button = Button::a;      return true;
+    case SDLK_s:     button = Button::b;      return true;
+    case SDLK_y:     button = Button::select; return true;
+    case SDLK_x:     button = Button::start;  return true;
+    }
+
+    return false;
+  }
+
   void _init_sdl()
   {
     if (SDL_Init(SDL_INIT_VIDEO) == -1) {
@@ -120,7 +163,7 @@ private:
       100,
       160 * _scale,
       144 * _scale,
-      SDL_WINDOW_SHOWN);
+      SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE);
 
     if (_main_win == nullptr) {
       std::cout << "SDL_CreateWindow Error: " << SDL_GetError() << std::endl;
@@ -133,6 +176,29 @@ private:
       SDL_Quit();
     }
 
+    // nearest neighbour, letterboxed to the aspect ratio of the screen
+    SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "0");
+    SDL_RenderSetLogicalSize(_main_ren, _gb.screen_width(), _gb.screen_height());
+    SDL_RenderSetIntegerScale(_main_ren, _integer_scale ? SDL_TRUE : SDL_FALSE);
+
+    _main_tex = SDL_CreateTexture(
+      _main_ren,
+      SDL_PIXELFORMAT_ARGB8888,
+      SDL_TEXTUREACCESS_STREAMING,
+      _gb.screen_width(),
+      _gb.screen_height());
+    if (_main_tex == nullptr) {
+      std::cout << "SDL_CreateTexture Error: " << SDL_GetError() << std::endl;
+      SDL_Quit();
+    }
+
+    // the frames come with host pixels in the texture format
+    _gb.rgba({{
+      0xFF9BBC0F,   // white
+      0xFF8BAC0F,   // light grey
+      0xFF306230,   // dark grey
+      0xFF0F380F }}); // black
+
     SDL_RenderClear(_main_ren);
   }
 
@@ -208,51 +274,77 @@ private:
     SDL_RenderClear(_tile2_ren);
   }
 
-  void _render_main(SDL_Renderer* r, GB const& gb)
+  // Uploads the changed lines of a new frame (host pixels from
+  // GB::rgba()) and lets the renderer scale the texture to the window.
+  void _render_main(SDL_Renderer* r, Frames::Frame const& frame)
   {
-    SDL_Rect rect;
-    rect.w = _scale;
-    rect.h = _scale;
-
-    auto const screen = gb.screen();
-    for (size_t i = 0; i < screen.size(); ++i) {
-      if (not _refresh and screen[i] == _last_screen[i])
-        continue;
-
-      auto const x = i % gb.screen_width();
-      auto const y = i / gb.screen_width();
-
-      switch(screen[i]) {
-      case 3: // black
-        SDL_SetRenderDrawColor(r,  15,  56,  15, 255);
-        break;
-      case 2: // dark grey
-        SDL_SetRenderDrawColor(r,  48,  98,  48, 255);
-        break;
-      case 1: // light grey
-        SDL_SetRenderDrawColor(r, 139, 172,  15, 255);
-        break;
-      default: // white
-        SDL_SetRenderDrawColor(r, 155, 188,  15, 255);
-        break;
+    int const width  = _gb.screen_width();
+    int const height = _gb.screen_height();
+
+    if (_refresh or frame.number != _last_number) {
+      int first = 0;
+      int last  = height;
+
+      // only the changed lines, unless frames were missed
+      if (not _refresh and frame.number == _last_number + 1) {
+        first = last;
+        last  = 0;
+        frame.dirty_ranges([&first, &last] (int y, int count) {
+          first = std::min(first, y);
+          last  = std::max(last, y + count);
+        });
       }
 
-      rect.x = x * rect.w;
-      rect.y = y * rect.h;
+      // every pixel of the locked rect is written, the texture does not
+      // keep its old content there
+      if (first < last) {
+        SDL_Rect const rect = { 0, first, width, last - first };
+
+        void* pixels;
+        int   pitch;
+        if (SDL_LockTexture(_main_tex, &rect, &pixels, &pitch) == 0) {
+          for (int y = first; y < last; ++y) {
+            std::memcpy(
+              static_cast<uint8_t*>(pixels) + (y - first) * pitch,
+              &frame.rgba[y * width],
+              width * sizeof(uint32_t));
+          }
+          SDL_UnlockTexture(_main_tex);
+        }
+      }
 
-      SDL_RenderFillRect(r, &rect);
+      _last_number = frame.number;
+      _refresh     = false;
     }
 
-    _last_screen = screen;
-    _refresh = false;
+    SDL_SetRenderDrawColor(r, 0, 0, 0, 255);
+    SDL_RenderClear(r);
+    SDL_RenderCopy(r, _main_tex, nullptr, nullptr);
   }
 
-  void _render_tiles(SDL_Renderer* r, GB const& gb, wide_reg_t tpsa)
+  // shows the speed in turbo mode
+  void _update_title()
+  {
+    float const speed = _emu.turbo() ? _emu.speed() : 0.0f;
+    if (speed == _title_speed)
+      return;
+
+    _title_speed = speed;
+
+    char title[64];
+    if (speed > 0.0f)
+      snprintf(title, sizeof(title), "GB Emulator (turbo %.1fx)", speed);
+    else
+      snprintf(title, sizeof(title), "GB Emulator");
+    SDL_SetWindowTitle(_main_win, title);
+  }
+
+  void _render_tiles(SDL_Renderer* r, Emulation::memory_t const& mem, wide_reg_t tpsa)
   {
     for (int i = 0; i < 256; ++i) {
       auto const x = i%16*8;
       auto const y = i/16*8;
-      _render_tile(tpsa, i, x, y, r, gb);
+      _render_tile(tpsa, i, x, y, r, mem);
     }
   }
 
@@ -262,17 +354,18 @@ private:
       int off_x,
       int off_y,
       SDL_Renderer* r,
-      GB const& gb)
+      Emulation::memory_t const& mem)
   {
     int y = 0;
     for (int i = 0; i < 16; i += 2) {
-      auto const byte1 = gb.mem(tpsaddr + i + 0 + (n*16));
-      auto const byte2 = gb.mem(tpsaddr + i + 1 + (n*16));
-      int x = 0;
-      for (int b = 7; b >= 0; --b) {
-        bool const bit1 = byte1 & (1 << b);
-        bool const bit2 = byte2 & (1 << b);
-        switch((static_cast<unsigned int>(bit2) << 1) | static_cast<unsigned int>(bit1)) {
+      auto const byte1 = mem[tpsaddr + i + 0 + (n*16)];
+      auto const byte2 = mem[tpsaddr + i + 1 + (n*16)];
+
+      reg_t row[8];
+      Pixels::decode(byte1, byte2, row);
+
+      for (int x = 0; x < 8; ++x) {
+        switch(row[x]) {
         case 3: // black
           SDL_SetRenderDrawColor(r,   0,   0,   0, 255);
           break;
@@ -288,14 +381,12 @@ private:
         }
 
         SDL_RenderDrawPoint(r, off_x + x, off_y + y);
-
-        ++x;
       }
       ++y;
     }
   }
 
-  void _render_memory(SDL_Renderer* r, GB const& gb)
+  void _render_memory(SDL_Renderer* r, Emulation::memory_t const& mem)
   {
     SDL_SetRenderDrawColor(r, 0, 0, 255, 255);
     SDL_RenderClear(r);
@@ -313,7 +404,7 @@ private:
     for (GB::wide_reg_t i = 0; i < 0xFFFF; ++i) {
       auto const y = i / width;
       auto const x = i % width;
-      auto const val = gb.mem(i);
+      auto const val = mem[i];
 
       if (i >= 0x8000 and i <  0x8800) {
         SDL_SetRenderDrawColor(r, 100,  20, val, 255);
@@ -343,13 +434,17 @@ private:
   }
 
 private:
-  GB& _gb;
+  GB&        _gb;
+  Emulation& _emu;
 
   bool      _running = true;
   int const _scale;
 
   SDL_Window*   _main_win = nullptr;
   SDL_Renderer* _main_ren = nullptr;
+  SDL_Texture*  _main_tex = nullptr;
+  bool          _integer_scale = true;
+  float         _title_speed   = 0.0f;
 
   SDL_Window*   _mem_win = nullptr;
   SDL_Renderer* _mem_ren = nullptr;
@@ -363,6 +458,6 @@ private:
   wide_reg_t const _tile_pattern_1_start = 0x8000;
   wide_reg_t const _tile_pattern_2_start = 0x8800;
 
-  GR::screen_t _last_screen;
+  uint64_t          _last_number = 0;
   bool              _refresh;
 };